@@ -1,12 +1,12 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <math.h>
-#include <stdbool.h>
-#include <stdint.h>
-#include <setjmp.h>
-#include "platform_dependency.c"
-
-#define ARRAY_COUNT(arr) (sizeof(arr) / sizeof(arr[0]))
+#define POSITION_TREE_STORAGE THREAD_LOCAL
+#ifdef DEBUG
+void export_position_tree(void);
+#define EXPORT_POSITION_TREE() export_position_tree()
+#endif
+#include "engine.c"
 
 char g_codepoints[] = { ' ', '.', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', ':', 'B', 'C',
 'D', 'I', 'L', 'N', 'Q', 'S', 'T', 'W', 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'k', 'l', 'm',
@@ -121,75 +121,10 @@ typedef union DialogControlCount
     char start[START_CONTROL_COUNT];
 } DialogControlCount;
 
-typedef enum PieceType
-{
-    PIECE_BISHOP,
-    PIECE_KING,
-    PIECE_KNIGHT,
-    PIECE_QUEEN,
-    PIECE_ROOK,
-    PIECE_PAWN,
-    PIECE_TYPE_COUNT
-} PieceType; 
-
-PieceType g_promotion_options[] = { PIECE_QUEEN, PIECE_ROOK, PIECE_BISHOP, PIECE_KNIGHT };
-
-typedef struct Piece
-{
-    uint8_t square_index;
-    uint8_t piece_type;
-} Piece;
-
-#define RANK_COUNT 8
-#define FILE_COUNT 8
-
-typedef struct Position
-{
-    uint8_t squares[RANK_COUNT * FILE_COUNT];
-    Piece pieces[32];
-    uint16_t node_index;
-    uint8_t en_passant_file;
-    uint8_t castling_rights_lost;
-    uint8_t active_player_index;
-    bool reset_draw_by_50_count;
-} Position;
-
-typedef struct CompressedPosition
-{
-    uint8_t square_mask[8];
-    uint8_t piece_hashes[16];
-    uint8_t en_passant_file;
-    uint8_t castling_rights_lost : 4;
-    uint8_t active_player_index : 1;
-} CompressedPosition;
-
-typedef struct PositionTreeNode
-{
-    int16_t evaluation;
-    uint16_t parent_index;
-    CompressedPosition position;
-    union
-    {
-        struct
-        {
-            uint16_t previous_leaf_index;
-            uint16_t next_leaf_index;
-        };
-        uint16_t first_move_node_index;
-    };
-    uint16_t next_move_node_index;
-    uint16_t next_transposion_index;
-    uint16_t index_of_next_position_with_same_hash;
-    bool is_leaf;
-    bool reset_draw_by_50_count : 1;
-    bool moves_have_been_found : 1;
-    bool is_canonical : 1;
-    bool evaluation_has_been_propagated_to_parents : 1;
-} PositionTreeNode;
-
 typedef struct PositionRecord
 {
     CompressedPosition position;
+    uint64_t zobrist_key;
     uint16_t index_of_next_record;
     uint8_t count;
     uint8_t generation;
@@ -258,19 +193,7 @@ typedef enum WindowIndex
 } WindowIndex;
 
 #define NULL_CONTROL UINT8_MAX
-#define NULL_PIECE 32
-#define NULL_SQUARE 64
-#define NULL_POSITION_TREE_NODE UINT16_MAX
 #define NULL_PLAYED_POSITION_RECORD UINT16_MAX
-#define PLAYER_INDEX_WHITE 0
-#define PLAYER_INDEX_BLACK 1
-
-PositionTreeNode g_position_tree_nodes[NULL_POSITION_TREE_NODE];
-uint16_t g_tree_position_buckets[NULL_POSITION_TREE_NODE];
-uint16_t g_selected_move_node_index;
-uint16_t g_first_leaf_index;
-uint16_t g_index_of_first_free_position_tree_node;
-uint16_t g_next_leaf_to_evaluate_index;
 
 PositionRecord*g_position_records;
 uint16_t g_external_position_record_count;
@@ -290,1232 +213,129 @@ uint64_t g_time_increment;
 uint32_t g_font_size;
 uint16_t g_seconds_left[2];
 uint16_t g_draw_by_50_count;
+uint16_t g_played_ply_count;
 DigitInput g_time_control[5];
 DigitInput g_increment[3];
-uint8_t g_active_player_index;
-uint8_t g_selected_piece_index;
-uint8_t g_selected_digit_id;
-uint8_t g_engine_player_index;
-bool g_run_engine;
-bool g_is_promoting;
-
-#ifdef DEBUG
-#define ASSERT(condition) if (!(condition)) *((int*)0) = 0
-
-void export_position_tree(void)
-{
-    if (g_active_player_index == g_engine_player_index)
-    {
-        HANDLE file_handle = CreateFileA("move_tree", GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
-        if (file_handle != INVALID_HANDLE_VALUE)
-        {
-            DWORD bytes_written;
-            WriteFile(file_handle, g_position_tree_nodes, sizeof(g_position_tree_nodes),
-                &bytes_written, 0);
-            CloseHandle(file_handle);
-        }
-    }
-}
-
-PositionTreeNode*get_position_tree_node(uint16_t node_index)
-{
-    ASSERT(node_index != NULL_POSITION_TREE_NODE);
-    return g_position_tree_nodes + node_index;
-}
-
-uint16_t get_previous_leaf_index(PositionTreeNode*node)
-{
-    ASSERT(node->is_leaf);
-    return node->previous_leaf_index;
-}
-
-uint16_t get_next_leaf_index(PositionTreeNode*node)
-{
-    ASSERT(node->is_leaf);
-    return node->next_leaf_index;
-}
-
-uint16_t get_first_move_node_index(PositionTreeNode*node)
-{
-    ASSERT(!node->is_leaf);
-    return node->first_move_node_index;
-}
-
-void set_previous_leaf_index(PositionTreeNode*node, uint16_t value)
-{
-    ASSERT(node->is_leaf);
-    node->previous_leaf_index = value;
-}
-
-void set_next_leaf_index(PositionTreeNode*node, uint16_t value)
-{
-    ASSERT(node->is_leaf);
-    node->next_leaf_index = value;
-}
-
-void set_first_move_node_index(PositionTreeNode*node, uint16_t value)
-{
-    ASSERT(!node->is_leaf);
-    node->first_move_node_index = value;
-}
-
-#define EXPORT_POSITION_TREE() export_position_tree()
-#define GET_POSITION_TREE_NODE(node_index) get_position_tree_node(node_index)
-#define GET_PREVIOUS_LEAF_INDEX(node) get_previous_leaf_index(node)
-#define GET_NEXT_LEAF_INDEX(position_tree_node) get_next_leaf_index(position_tree_node)
-#define GET_FIRST_MOVE_NODE_INDEX(node) get_first_move_node_index(node)
-#define SET_PREVIOUS_LEAF_INDEX(position_tree_node, value) set_previous_leaf_index(position_tree_node, value)
-#define SET_NEXT_LEAF_INDEX(position_tree_node, value) set_next_leaf_index(position_tree_node, value)
-#define SET_FIRST_MOVE_NODE_INDEX(node, value) set_first_move_node_index(node, value)
-#else
-#define ASSERT(condition)
-#define EXPORT_POSITION_TREE()
-#define GET_POSITION_TREE_NODE(node_index) (g_position_tree_nodes + (node_index))
-#define GET_PREVIOUS_LEAF_INDEX(position_tree_node) (position_tree_node)->previous_leaf_index
-#define GET_NEXT_LEAF_INDEX(position_tree_node) (position_tree_node)->next_leaf_index
-#define GET_FIRST_MOVE_NODE_INDEX(node) (node)->first_move_node_index
-#define SET_PREVIOUS_LEAF_INDEX(position_tree_node, value) ((position_tree_node)->previous_leaf_index = (value))
-#define SET_NEXT_LEAF_INDEX(position_tree_node, value) ((position_tree_node)->next_leaf_index = (value))
-#define SET_FIRST_MOVE_NODE_INDEX(node, value) ((node)->first_move_node_index = (value))
-#endif
-
-#define PLAYER_INDEX(piece_index) ((piece_index) >> 4)
-#define KING_RANK(player_index) (7 * !(player_index))
-#define FORWARD_DELTA(player_index) (((player_index) << 1) - 1)
-#define RANK(square_index) ((square_index) >> 3)
-#define FILE(square_index) ((square_index) & 0b111)
-#define SCREEN_SQUARE_INDEX(square_index) (g_engine_player_index == PLAYER_INDEX_WHITE ? (63 - (square_index)) : (square_index))
-#define SQUARE_INDEX(rank, file) (FILE_COUNT * (rank) + (file))
-#define EXTERNAL_POSITION_RECORDS() (g_position_records + g_position_record_bucket_count)
-#define PLAYER_PIECES_INDEX(player_index) ((player_index) << 4)
-#define EN_PASSANT_RANK(player_index, forward_delta) KING_RANK(player_index) + ((forward_delta) << 2)
-#define PLAYER_WIN(player_index) (((int16_t[]){INT16_MAX, -INT16_MAX})[player_index])
-
-uint64_t g_counts_per_second;
-uint64_t g_max_time;
-
-void init_position_archive(uint8_t bucket_count)
-{
-    g_played_position_generation = 0;
-    g_position_record_bucket_count = bucket_count;
-    g_position_records = ALLOCATE(2 * sizeof(PositionRecord) * bucket_count);
-    for (size_t i = 0; i < bucket_count; ++i)
-    {
-        g_position_records[i] =
-            (PositionRecord) { (CompressedPosition) { 0 }, NULL_POSITION_TREE_NODE, 0, 0 };
-    }
-    g_unique_played_position_count = 0;
-    g_external_position_record_count = 0;
-}
-
-bool archive_position(CompressedPosition*position);
-
-void increment_unique_position_count(void)
-{
-    ++g_unique_played_position_count;
-    if (g_unique_played_position_count == g_position_record_bucket_count)
-    {
-        PositionRecord*old_buckets = g_position_records;
-        PositionRecord*old_external_records = EXTERNAL_POSITION_RECORDS();
-        init_position_archive(g_position_record_bucket_count << 1);
-        for (size_t i = 0; i < g_position_record_bucket_count; ++i)
-        {
-            PositionRecord*record = old_buckets + i;
-            if (record->count && record->generation == g_played_position_generation)
-            { 
-                while (true)
-                {
-                    archive_position(&record->position);
-                    if (record->index_of_next_record < NULL_PLAYED_POSITION_RECORD)
-                    {
-                        record = old_external_records + record->index_of_next_record;
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-            }
-        }
-        FREE_MEMORY(old_buckets);
-    }
-}
-
-uint32_t FNVHashCompressedPosition(CompressedPosition*position, uint16_t bit_count)
-{
-    uint32_t hash = 2166136261;
-    for (size_t i = 0; i < sizeof(CompressedPosition); ++i)
-    {
-        hash ^= ((uint8_t*)position)[i];
-        hash *= 16777619;
-    }
-    return ((hash >> bit_count) ^ hash) & ((1 << bit_count) - 1);
-}
-
-bool archive_position(CompressedPosition*position)
-{
-    uint32_t bucket_count_bit_count;
-    BIT_SCAN_REVERSE(&bucket_count_bit_count, g_position_record_bucket_count);
-    uint32_t bucket_index = FNVHashCompressedPosition(position, bucket_count_bit_count);
-    PositionRecord*record = g_position_records + bucket_index;
-    if (record->count && record->generation == g_played_position_generation)
-    {
-        while (memcmp(position, &record->position, sizeof(CompressedPosition)))
-        {
-            if (record->index_of_next_record == NULL_PLAYED_POSITION_RECORD)
-            {
-                record->index_of_next_record = g_external_position_record_count;
-                EXTERNAL_POSITION_RECORDS()[g_external_position_record_count] =
-                    (PositionRecord) { *position, NULL_PLAYED_POSITION_RECORD, 1,
-                        g_played_position_generation };
-                ++g_external_position_record_count;
-                increment_unique_position_count();
-                return true;
-            }
-            else
-            {
-                record = EXTERNAL_POSITION_RECORDS() + record->index_of_next_record;
-            }
-        }
-        ++record->count;
-        if (record->count == 3)
-        {
-            return false;
-        }
-    }
-    else
-    {
-        record->position = *position;
-        record->index_of_next_record = NULL_PLAYED_POSITION_RECORD;
-        record->count = 1;
-        record->generation = g_played_position_generation;
-        increment_unique_position_count();
-    }
-    return true;
-}
-
-typedef enum Direction
-{
-    DIRECTION_N,
-    DIRECTION_E,
-    DIRECTION_S,
-    DIRECTION_W,
-    DIRECTION_NE,
-    DIRECTION_SE,
-    DIRECTION_SW,
-    DIRECTION_NW,
-    DIRECTION_NNE,
-    DIRECTION_ENE,
-    DIRECTION_ESE,
-    DIRECTION_SSE,
-    DIRECTION_SSW,
-    DIRECTION_WSW,
-    DIRECTION_WNW,
-    DIRECTION_NNW
-} Direction;
-
-int8_t g_direction_deltas[16][2] = { [DIRECTION_N] = { 1, 0 },[DIRECTION_E] = { 0, 1 },
-[DIRECTION_S] = { -1, 0 },[DIRECTION_W] = { 0, -1 },[DIRECTION_NE] = { 1, 1 },
-[DIRECTION_SE] = { -1, 1 },[DIRECTION_SW] = { -1, -1 },[DIRECTION_NW] = { 1, -1 },
-[DIRECTION_NNE] = { 2, 1 },[DIRECTION_ENE] = { 1, 2 },[DIRECTION_ESE] = { -1, 2 },
-[DIRECTION_SSE] = { -2, 1 },[DIRECTION_SSW] = { -2, -1 },[DIRECTION_WSW] = { -1, -2 },
-[DIRECTION_WNW] = { 1, -2 },[DIRECTION_NNW] = { 2, -1 } };
-
-void increment_control_counts_along_half_diagonal(Position*position, int8_t control_counts[64],
-    uint8_t piece_square_index, uint8_t player_index, int8_t rank_delta, int8_t file_delta)
-{
-    int8_t point = FORWARD_DELTA(!player_index);
-    uint8_t rank = RANK(piece_square_index);
-    uint8_t file = FILE(piece_square_index);
-    while (true)
-    {
-        rank += rank_delta;
-        if (rank > 7)
-        {
-            return;
-        }
-        file += file_delta;
-        if (file > 7)
-        {
-            return;
-        }
-        piece_square_index = SQUARE_INDEX(rank, file);
-        control_counts[piece_square_index] += point;
-        if (position->squares[piece_square_index] != NULL_PIECE)
-        {
-            return;
-        }
-    }
-}
-
-void increment_control_counts_along_diagonals(Position*position, int8_t control_counts[64],
-    uint8_t piece_square_index, uint8_t player_index)
-{
-    increment_control_counts_along_half_diagonal(position, control_counts, piece_square_index,
-        player_index, 1, 1);
-    increment_control_counts_along_half_diagonal(position, control_counts, piece_square_index,
-        player_index, 1, -1);
-    increment_control_counts_along_half_diagonal(position, control_counts, piece_square_index,
-        player_index, -1, 1);
-    increment_control_counts_along_half_diagonal(position, control_counts, piece_square_index,
-        player_index, -1, -1);
-}
-
-void increment_control_counts_along_half_rank(Position*position, int8_t control_counts[64],
-    uint8_t piece_square_index, uint8_t player_index, int8_t delta)
-{
-    int8_t point = FORWARD_DELTA(!player_index);
-    uint8_t rank = RANK(piece_square_index);
-    uint8_t file = FILE(piece_square_index);
-    while (true)
-    {
-        file += delta;
-        if (file > 7)
-        {
-            return;
-        }
-        piece_square_index = SQUARE_INDEX(rank, file);
-        control_counts[piece_square_index] += point;
-        if (position->squares[piece_square_index] != NULL_PIECE)
-        {
-            return;
-        }
-    }
-}
-
-void increment_control_counts_along_half_file(Position*position, int8_t control_counts[64],
-    uint8_t piece_square_index, uint8_t player_index, int8_t delta)
-{
-    int8_t point = FORWARD_DELTA(!player_index);
-    uint8_t rank = RANK(piece_square_index);
-    uint8_t file = FILE(piece_square_index);
-    while (true)
-    {
-        rank += delta;
-        if (rank > 7)
-        {
-            return;
-        }
-        piece_square_index = SQUARE_INDEX(rank, file);
-        control_counts[piece_square_index] += point;
-        if (position->squares[piece_square_index] != NULL_PIECE)
-        {
-            return;
-        }
-    }
-}
-
-void increment_control_counts_along_axes(Position*position, int8_t control_counts[64],
-    uint8_t piece_square_index, uint8_t player_index)
-{
-    increment_control_counts_along_half_rank(position, control_counts, piece_square_index,
-        player_index, 1);
-    increment_control_counts_along_half_rank(position, control_counts, piece_square_index,
-        player_index, -1);
-    increment_control_counts_along_half_file(position, control_counts, piece_square_index,
-        player_index, 1);
-    increment_control_counts_along_half_file(position, control_counts, piece_square_index,
-        player_index, -1);
-}
-
-size_t add_knight_destination_square_indices(uint8_t destination_square_indices[8],
-    uint8_t knight_square_index)
-{
-    size_t count = 0;
-    uint8_t rank = RANK(knight_square_index);
-    uint8_t file = FILE(knight_square_index);
-    for (Direction direction = 8; direction < 16; ++direction)
-    {
-        uint8_t destination_rank = rank + g_direction_deltas[direction][0];
-        if (destination_rank < 8)
-        {
-            uint8_t destination_file = file + g_direction_deltas[direction][1];
-            if (destination_file < 8)
-            {
-                destination_square_indices[count] = SQUARE_INDEX(destination_rank, destination_file);
-                ++count;
-            }
-        }
-    }
-    return count;
-}
-
-size_t add_king_move_ranks_or_files(uint8_t move_ranks_or_files[3], uint8_t king_rank_or_file)
-{
-    size_t count = 0;
-    if (king_rank_or_file)
-    {
-        move_ranks_or_files[count] = king_rank_or_file - 1;
-        ++count;
-    }
-    move_ranks_or_files[count] = king_rank_or_file;
-    ++count;
-    if (king_rank_or_file < 7)
-    {
-        move_ranks_or_files[count] = king_rank_or_file + 1;
-        ++count;
-    }
-    return count;
-}
-
-void increment_square_control_counts(Position*position, int8_t control_counts[64],
-    uint8_t player_index)
-{
-    uint8_t player_pieces_index = PLAYER_PIECES_INDEX(player_index);
-    uint8_t max_piece_index = player_pieces_index + 16;
-    for (uint8_t piece_index = player_pieces_index; piece_index < max_piece_index; ++piece_index)
-    {
-        Piece piece = position->pieces[piece_index];
-        if (piece.square_index == NULL_SQUARE)
-        {
-            continue;
-        }
-        uint8_t player_index = PLAYER_INDEX(piece_index);
-        switch (piece.piece_type)
-        {
-        case PIECE_PAWN:
-        {
-            int8_t forward_delta = FORWARD_DELTA(player_index);
-            uint8_t rank = RANK(piece.square_index) + forward_delta;
-            if (rank < 8)
-            {
-                uint8_t file = FILE(piece.square_index);
-                if (file)
-                {
-                    control_counts[SQUARE_INDEX(rank, file - 1)] -= forward_delta;
-                }
-                if (file < 7)
-                {
-                    control_counts[SQUARE_INDEX(rank, file + 1)] -= forward_delta;
-                }
-            }
-            break;
-        }
-        case PIECE_BISHOP:
-        {
-            increment_control_counts_along_diagonals(position, control_counts, piece.square_index,
-                player_index);
-            break;
-        }
-        case PIECE_KING:
-        {
-            uint8_t move_ranks[3];
-            size_t move_rank_count =
-                add_king_move_ranks_or_files(move_ranks, RANK(piece.square_index));
-            uint8_t move_files[3];
-            size_t move_file_count =
-                add_king_move_ranks_or_files(move_files, FILE(piece.square_index));
-            int8_t point = FORWARD_DELTA(!player_index);
-            for (size_t rank_index = 0; rank_index < move_rank_count; ++rank_index)
-            {
-                for (size_t file_index = 0; file_index < move_file_count; ++file_index)
-                {
-                    control_counts[SQUARE_INDEX(move_ranks[rank_index], move_files[file_index])] +=
-                        point;
-                }
-            }
-            control_counts[piece.square_index] -= point;
-            break;
-        }
-        case PIECE_KNIGHT:
-        {
-            int8_t point = FORWARD_DELTA(!player_index);
-            uint8_t destination_square_indices[8];
-            size_t square_count = add_knight_destination_square_indices(destination_square_indices,
-                piece.square_index);
-            for (size_t i = 0; i < square_count; ++i)
-            {
-                control_counts[destination_square_indices[i]] += point;
-            }
-            break;
-        }
-        case PIECE_ROOK:
-        {
-            increment_control_counts_along_axes(position, control_counts, piece.square_index,
-                player_index);
-            break;
-        }
-        case PIECE_QUEEN:
-        {
-            increment_control_counts_along_diagonals(position, control_counts, piece.square_index,
-                player_index);
-            increment_control_counts_along_axes(position, control_counts, piece.square_index,
-                player_index);
-            break;
-        }
-        }
-    }
-}
-
-void capture_piece(Position*position, uint8_t piece_index)
-{
-    position->pieces[piece_index].square_index = NULL_SQUARE;
-    position->reset_draw_by_50_count = true;
-}
-
-void move_piece(Position*position, uint8_t piece_index, uint8_t destination_square_index)
-{
-    position->squares[destination_square_index] = piece_index;
-    Piece*piece = position->pieces + piece_index;
-    position->squares[piece->square_index] = NULL_PIECE;
-    piece->square_index = destination_square_index;
-}
-
-uint16_t get_position_record_bucket_index(CompressedPosition*position)
-{
-    uint16_t out = FNVHashCompressedPosition(position, 16);
-    if (out == NULL_POSITION_TREE_NODE)
-    {
-        return 0;
-    }
-    return out;
-}
-
-jmp_buf out_of_memory_jump_buffer;
-
-uint16_t allocate_position_tree_node(void)
-{
-    if (g_index_of_first_free_position_tree_node == NULL_POSITION_TREE_NODE)
-    {
-        g_run_engine = false;
-        longjmp(out_of_memory_jump_buffer, 1);
-    }
-    else
-    {
-        uint16_t new_node_index = g_index_of_first_free_position_tree_node;
-        ++g_index_of_first_free_position_tree_node;
-        PositionTreeNode*new_node = GET_POSITION_TREE_NODE(new_node_index);
-        new_node->is_leaf = true;
-        new_node->moves_have_been_found = false;
-        return new_node_index;
-    }
-}
-
-void compress_position(CompressedPosition*out, Position*position)
-{
-    memset(out->square_mask, 0, sizeof(out->square_mask));
-    memset(out->piece_hashes, 0, sizeof(out->piece_hashes));
-    size_t piece_hash_index = 0;
-    uint8_t shift = 0;
-    for (size_t square_index = 0; square_index < 64; ++square_index)
-    {
-        uint8_t square = position->squares[square_index];
-        if (square != NULL_PIECE)
-        {
-            out->piece_hashes[piece_hash_index] |= (position->pieces[square].piece_type |
-                (PLAYER_INDEX(square) << 3)) << shift;
-            piece_hash_index += shift >> 2;
-            shift ^= 4;
-            out->square_mask[square_index >> 3] |= 1 << (square_index & 0b111);
-        }
-    }
-    out->en_passant_file = position->en_passant_file;
-    out->castling_rights_lost = position->castling_rights_lost;
-    out->active_player_index = position->active_player_index;
-}
-
-void compress_position_to_node(Position*position, int16_t evaluation)
-{
-    PositionTreeNode*node = GET_POSITION_TREE_NODE(position->node_index);
-    node->reset_draw_by_50_count = position->reset_draw_by_50_count;
-    compress_position(&node->position, position);
-    uint16_t*index_of_position_with_same_hash =
-        g_tree_position_buckets + get_position_record_bucket_index(&node->position);
-    while (true)
-    {
-        if (*index_of_position_with_same_hash == NULL_POSITION_TREE_NODE)
-        {
-            node->is_canonical = true;
-            node->index_of_next_position_with_same_hash = NULL_POSITION_TREE_NODE;
-            node->next_transposion_index = NULL_POSITION_TREE_NODE;
-            node->evaluation = evaluation;
-            *index_of_position_with_same_hash = position->node_index;
-            return;
-        }
-        PositionTreeNode*position_with_same_hash =
-            GET_POSITION_TREE_NODE(*index_of_position_with_same_hash);
-        if (memcmp(&node->position, &position_with_same_hash->position, sizeof(node->position)))
-        {
-            index_of_position_with_same_hash =
-                &position_with_same_hash->index_of_next_position_with_same_hash;
-        }
-        else
-        {
-            node->is_canonical = false;
-            node->next_transposion_index = position_with_same_hash->next_transposion_index;
-            position_with_same_hash->next_transposion_index = position->node_index;
-            node->evaluation = position_with_same_hash->evaluation;
-            node->evaluation_has_been_propagated_to_parents = false;
-            return;
-        }
-    }
-}
-
-void decompress_position(Position*out, uint16_t position_tree_node_index)
-{
-    CompressedPosition*position = &GET_POSITION_TREE_NODE(position_tree_node_index)->position;
-    out->node_index = position_tree_node_index;
-    uint8_t player_next_piece_index[] = { 1, 17 };
-    size_t piece_hash_index = 0;
-    uint8_t shift = 0;
-    for (size_t square_index = 0; square_index < 64; ++square_index)
-    {
-        if (position->square_mask[square_index >> 3] & (1 << (square_index & 0b111)))
-        {
-            uint8_t piece_hash = (position->piece_hashes[piece_hash_index] >> shift) & 0b1111;
-            uint8_t player_index = piece_hash >> 3;
-            PieceType piece_type = piece_hash & 0b111;
-            uint8_t piece_index;
-            if (piece_type == PIECE_KING)
-            {
-                piece_index = PLAYER_PIECES_INDEX(player_index);
-            }
-            else
-            {
-                piece_index = player_next_piece_index[player_index];
-                ++player_next_piece_index[player_index];
-            }
-            out->squares[square_index] = piece_index;
-            Piece*piece = out->pieces + piece_index;
-            piece->square_index = square_index;
-            piece->piece_type = piece_type;
-            piece_hash_index += shift >> 2;
-            shift ^= 4;
-        }
-        else
-        {
-            out->squares[square_index] = NULL_PIECE;
-        }
-    }
-    for (size_t piece_index = player_next_piece_index[0]; piece_index < 16; ++piece_index)
-    {
-        out->pieces[piece_index].square_index = NULL_SQUARE;
-    }
-    for (size_t piece_index = player_next_piece_index[1]; piece_index < 32; ++piece_index)
-    {
-        out->pieces[piece_index].square_index = NULL_SQUARE;
-    }
-    out->en_passant_file = position->en_passant_file;
-    out->castling_rights_lost = position->castling_rights_lost;
-    out->active_player_index = position->active_player_index;
-}
-
-void add_move(Position*position, Position*move, int16_t evaluation)
-{
-    move->node_index = allocate_position_tree_node();
-    PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move->node_index);
-    move_node->parent_index = position->node_index;
-    PositionTreeNode*node = GET_POSITION_TREE_NODE(position->node_index);
-    if (node->is_leaf)
-    {
-        SET_PREVIOUS_LEAF_INDEX(move_node, GET_PREVIOUS_LEAF_INDEX(node));
-        SET_NEXT_LEAF_INDEX(move_node, GET_NEXT_LEAF_INDEX(node));
-        if (GET_NEXT_LEAF_INDEX(move_node) != NULL_POSITION_TREE_NODE)
-        {
-            SET_PREVIOUS_LEAF_INDEX(GET_POSITION_TREE_NODE(GET_NEXT_LEAF_INDEX(move_node)),
-                move->node_index);
-        }
-        node->is_leaf = false;
-        move_node->next_move_node_index = NULL_POSITION_TREE_NODE;
-    }
-    else
-    {
-        PositionTreeNode*next_move_node = GET_POSITION_TREE_NODE(GET_FIRST_MOVE_NODE_INDEX(node));
-        SET_PREVIOUS_LEAF_INDEX(move_node, GET_PREVIOUS_LEAF_INDEX(next_move_node));
-        SET_NEXT_LEAF_INDEX(move_node, GET_FIRST_MOVE_NODE_INDEX(node));
-        SET_PREVIOUS_LEAF_INDEX(next_move_node, move->node_index);
-        move_node->next_move_node_index = GET_FIRST_MOVE_NODE_INDEX(node);
-    }
-    if (GET_PREVIOUS_LEAF_INDEX(move_node) == NULL_POSITION_TREE_NODE)
-    {
-        g_first_leaf_index = move->node_index;
-    }
-    else
-    {
-        SET_NEXT_LEAF_INDEX(GET_POSITION_TREE_NODE(GET_PREVIOUS_LEAF_INDEX(move_node)),
-            move->node_index);
-    }
-    SET_FIRST_MOVE_NODE_INDEX(node, move->node_index);
-    compress_position_to_node(move, evaluation);
-}
-
-uint8_t abs_delta(uint8_t a, uint8_t b)
-{
-    if (a > b)
-    {
-        return a - b;
-    }
-    return b - a;
-}
-
-int32_t min32(int32_t a, int32_t b)
-{
-    if (a < b)
-    {
-        return a;
-    }
-    return b;
-}
-
-uint32_t max32(uint32_t a, uint32_t b)
-{
-    if (a > b)
-    {
-        return a;
-    }
-    return b;
-}
-
-int16_t get_king_safety_evaluation(Position*position, int8_t square_control_counts[64])
-{
-    increment_square_control_counts(position, square_control_counts,
-        !position->active_player_index);
-    uint8_t white_king_square_index =
-        position->pieces[PLAYER_PIECES_INDEX(PLAYER_INDEX_WHITE)].square_index;
-    uint8_t white_king_rank = RANK(white_king_square_index);
-    uint8_t white_king_file = FILE(white_king_square_index);
-    uint8_t black_king_square_index =
-        position->pieces[PLAYER_PIECES_INDEX(PLAYER_INDEX_BLACK)].square_index;
-    uint8_t black_king_rank = RANK(black_king_square_index);
-    uint8_t black_king_file = FILE(black_king_square_index);
-    int16_t out = 0;
-    for (uint8_t rank = 0; rank < 8; ++rank)
-    {
-        uint16_t white_rank_delta = abs_delta(rank, white_king_rank);
-        uint16_t black_rank_delta = abs_delta(rank, black_king_rank);
-        for (uint8_t file = 0; file < 8; ++file)
-        {
-            int16_t control_count = square_control_counts[SQUARE_INDEX(rank, file)];
-            int16_t abs_count;
-            int16_t sign;
-            if (control_count < 0)
-            {
-                abs_count = -control_count;
-                sign = -1;
-            }
-            else
-            {
-                abs_count = control_count;
-                sign = 1;
-            }
-            out += (14 - (max32(white_rank_delta, abs_delta(file, white_king_file)) +
-                max32(black_rank_delta, abs_delta(file, black_king_file)))) *
-                sign * (16 * abs_count - (abs_count * (abs_count - 1)) / 2);
-        }
-    }
-    return out;
-}
-
-bool add_move_if_not_king_hang(Position*position, Position*move)
-{
-    int8_t control_counts[64] = { 0 };
-    increment_square_control_counts(move, control_counts, move->active_player_index);
-    if (control_counts
-        [position->pieces[PLAYER_PIECES_INDEX(position->active_player_index)].square_index])
-    {
-        return false;
-    }
-    add_move(position, move, get_king_safety_evaluation(move, control_counts));
-    return true;
-}
-
-void copy_position(Position*position, Position*out)
-{
-    memcpy(&out->squares, &position->squares, sizeof(position->squares));
-    memcpy(&out->pieces, &position->pieces, sizeof(position->pieces));
-    out->active_player_index = !position->active_player_index;
-    out->en_passant_file = FILE_COUNT;
-    out->castling_rights_lost = position->castling_rights_lost;
-    out->reset_draw_by_50_count = false;
-}
-
-typedef enum MoveAttemptStatus
-{
-    MOVE_ATTEMPT_OBSTRUCTION,
-    MOVE_ATTEMPT_HANG,
-    MOVE_ATTEMPT_MOVE,
-    MOVE_ATTEMPT_CAPTURE
-} MoveAttemptStatus;
-
-MoveAttemptStatus attempt_piece_move(Position*position, Position*move, int8_t control_counts[64],
-    uint8_t piece_index, uint8_t destination_square_index)
-{
-    uint8_t destination_square = position->squares[destination_square_index];
-    MoveAttemptStatus out;
-    if (destination_square == NULL_PIECE)
-    {
-        copy_position(position, move);
-        out = MOVE_ATTEMPT_MOVE;
-    }
-    else if (PLAYER_INDEX(destination_square) != position->active_player_index)
-    {
-        copy_position(position, move);
-        capture_piece(move, destination_square);
-        out = MOVE_ATTEMPT_CAPTURE;
-    }
-    else
-    {
-        return MOVE_ATTEMPT_OBSTRUCTION;
-    }
-    move_piece(move, piece_index, destination_square_index);
-    memset(control_counts, 0, 64);
-    increment_square_control_counts(move, control_counts, move->active_player_index);
-    if (control_counts
-        [move->pieces[PLAYER_PIECES_INDEX(position->active_player_index)].square_index])
-    {
-        return MOVE_ATTEMPT_HANG;
-    }
-    return out;
-}
-
-MoveAttemptStatus move_piece_and_add_as_move(Position*position, uint8_t piece_index,
-    uint8_t destination_square_index)
-{
-    int8_t control_counts[64];
-    Position move;
-    MoveAttemptStatus out =
-        attempt_piece_move(position, &move, control_counts, piece_index, destination_square_index);
-    switch (out)
-    {
-    case MOVE_ATTEMPT_MOVE:
-    case MOVE_ATTEMPT_CAPTURE:
-    {
-        add_move(position, &move, get_king_safety_evaluation(&move, control_counts));
-    }
-    }
-    return out;
-}
-
-void add_pawn_move_with_promotions(Position*position, Position*move, uint8_t piece_index)
-{
-    int8_t control_counts[64] = { 0 };
-    increment_square_control_counts(move, control_counts, move->active_player_index);
-    if (!control_counts
-        [position->pieces[PLAYER_PIECES_INDEX(position->active_player_index)].square_index])
-    {
-        if (RANK(move->pieces[piece_index].square_index) == KING_RANK(!PLAYER_INDEX(piece_index)))
-        {
-            move->reset_draw_by_50_count = true;
-            for (size_t i = 0; i < ARRAY_COUNT(g_promotion_options); ++i)
-            {
-                move->pieces[piece_index].piece_type = g_promotion_options[i];
-                int8_t control_counts_copy[64];
-                memcpy(control_counts_copy, control_counts, sizeof(control_counts));
-                add_move(position, move, get_king_safety_evaluation(move, control_counts_copy));
-            }
-        }
-        else
-        {
-            int8_t control_counts_copy[64];
-            memcpy(control_counts_copy, control_counts, sizeof(control_counts));
-            add_move(position, move, get_king_safety_evaluation(move, control_counts_copy));
-        }
-    }
-}
+uint8_t g_active_player_index;
+uint8_t g_selected_piece_index;
+uint8_t g_selected_move_index;
+uint8_t g_selected_digit_id;
+uint8_t g_engine_player_index;
+bool g_is_promoting;
+bool g_ponder;
 
-void add_diagonal_pawn_move(Position*position, uint8_t piece_index, uint8_t file)
+#ifdef DEBUG
+void export_position_tree(void)
 {
-    uint8_t rank = RANK(position->pieces[piece_index].square_index);
-    int8_t forward_delta = FORWARD_DELTA(position->active_player_index);
-    uint8_t destination_square_index = SQUARE_INDEX(rank + forward_delta, file);
-    if (file == position->en_passant_file && rank ==
-        EN_PASSANT_RANK(position->active_player_index, forward_delta))
-    {
-        Position move;
-        copy_position(position, &move);
-        uint8_t en_passant_square_index = SQUARE_INDEX(rank, file);
-        capture_piece(&move, position->squares[en_passant_square_index]);
-        move_piece(&move, piece_index, destination_square_index);
-        move.squares[en_passant_square_index] = NULL_PIECE;
-        add_move_if_not_king_hang(position, &move);
-    }
-    else
+    if (g_engine_position.active_player_index == g_engine_player_index)
     {
-        uint8_t destination_square = position->squares[destination_square_index];
-        if (PLAYER_INDEX(destination_square) == !position->active_player_index)
+        HANDLE file_handle = CreateFileA("move_tree", GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+        if (file_handle != INVALID_HANDLE_VALUE)
         {
-            Position move;
-            copy_position(position, &move);
-            capture_piece(&move, destination_square);
-            move_piece(&move, piece_index, destination_square_index);
-            add_pawn_move_with_promotions(position, &move, piece_index);
+            DWORD bytes_written;
+            WriteFile(file_handle, g_position_tree_nodes,
+                g_index_of_first_free_position_tree_node * sizeof(PositionTreeNode),
+                &bytes_written, 0);
+            CloseHandle(file_handle);
         }
     }
 }
 
-void add_moves_in_direction(Position*position, Direction direction, uint8_t piece_index,
-    uint8_t castling_right_lost)
-{
-    uint8_t destination_square_index = position->pieces[piece_index].square_index;
-    uint8_t destination_rank = RANK(destination_square_index);
-    uint8_t destination_file = FILE(destination_square_index);
-    int8_t rank_delta = g_direction_deltas[direction][0];
-    int8_t file_delta = g_direction_deltas[direction][1];
-    while (true)
-    {
-        destination_rank += rank_delta;
-        if (destination_rank > 7)
-        {
-            return;
-        }
-        destination_file += file_delta;
-        if (destination_file > 7)
-        {
-            return;
-        }
-        int8_t control_counts[64];
-        Position move;
-        MoveAttemptStatus status = attempt_piece_move(position, &move, control_counts, piece_index,
-            SQUARE_INDEX(destination_rank, destination_file));
-        if (status == MOVE_ATTEMPT_OBSTRUCTION)
-        {
-            return;
-        }
-        if (status != MOVE_ATTEMPT_HANG)
-        {
-            if (!(move.castling_rights_lost & castling_right_lost))
-            {
-                move.castling_rights_lost |= castling_right_lost;
-                move.reset_draw_by_50_count |= castling_right_lost;
-            }
-            add_move(position, &move, get_king_safety_evaluation(&move, control_counts));
-            if (status == MOVE_ATTEMPT_CAPTURE)
-            {
-                return;
-            }
-        }
-    }
-}
+#endif
 
-void add_moves_along_axes(Position*position, uint8_t piece_index, uint8_t castling_right_lost)
-{
-    for (size_t direction = 0; direction < 4; ++direction)
-    {
-        add_moves_in_direction(position, direction, piece_index, castling_right_lost);
-    }
-}
+#define SCREEN_SQUARE_INDEX(square_index) (g_engine_player_index == PLAYER_INDEX_WHITE ? (63 - (square_index)) : (square_index))
+#define EXTERNAL_POSITION_RECORDS() (g_position_records + g_position_record_bucket_count)
 
-void add_diagonal_moves(Position*position, uint8_t piece_index)
-{
-    for (size_t direction = 4; direction < 8; ++direction)
-    {
-        add_moves_in_direction(position, direction, piece_index, 0);
-    }
-}
+uint64_t g_counts_per_second;
+uint64_t g_max_time;
 
-void propagate_evaluation_to_transpositions(PositionTreeNode*node)
+void init_position_archive(uint8_t bucket_count)
 {
-    ASSERT(node->is_canonical);
-    int16_t evaluation = node->evaluation;
-    while (node->next_transposion_index != NULL_POSITION_TREE_NODE)
+    g_played_position_generation = 0;
+    g_position_record_bucket_count = bucket_count;
+    g_position_records = ALLOCATE(2 * sizeof(PositionRecord) * bucket_count);
+    for (size_t i = 0; i < bucket_count; ++i)
     {
-        node = GET_POSITION_TREE_NODE(node->next_transposion_index);
-        node->evaluation = evaluation;
-        node->evaluation_has_been_propagated_to_parents = false;
+        g_position_records[i] =
+            (PositionRecord) { (CompressedPosition) { 0 }, 0, NULL_PLAYED_POSITION_RECORD, 0, 0 };
     }
+    g_unique_played_position_count = 0;
+    g_external_position_record_count = 0;
 }
 
-void propagate_evaluation_to_parents(PositionTreeNode*node)
+bool archive_position(CompressedPosition*position, uint64_t zobrist_key);
+
+void increment_unique_position_count(void)
 {
-    node->evaluation_has_been_propagated_to_parents = true;
-    while (node->parent_index != NULL_POSITION_TREE_NODE)
+    ++g_unique_played_position_count;
+    if (g_unique_played_position_count == g_position_record_bucket_count)
     {
-        int16_t new_evaluation = PLAYER_WIN(node->position.active_player_index);
-        node = GET_POSITION_TREE_NODE(node->parent_index);
-        uint16_t move_node_index = GET_FIRST_MOVE_NODE_INDEX(node);
-        while (move_node_index != NULL_POSITION_TREE_NODE)
+        PositionRecord*old_buckets = g_position_records;
+        PositionRecord*old_external_records = EXTERNAL_POSITION_RECORDS();
+        init_position_archive(g_position_record_bucket_count << 1);
+        for (size_t i = 0; i < g_position_record_bucket_count; ++i)
         {
-            PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
-            if (node->position.active_player_index == PLAYER_INDEX_WHITE)
-            {
-                if (move_node->evaluation > new_evaluation)
+            PositionRecord*record = old_buckets + i;
+            if (record->count && record->generation == g_played_position_generation)
+            { 
+                while (true)
                 {
-                    new_evaluation = move_node->evaluation;
+                    archive_position(&record->position, record->zobrist_key);
+                    if (record->index_of_next_record < NULL_PLAYED_POSITION_RECORD)
+                    {
+                        record = old_external_records + record->index_of_next_record;
+                    }
+                    else
+                    {
+                        break;
+                    }
                 }
             }
-            else if (move_node->evaluation < new_evaluation)
-            {
-                new_evaluation = move_node->evaluation;
-            }
-            move_node_index = move_node->next_move_node_index;
         }
-        if (new_evaluation == node->evaluation)
-        {
-            return;
-        }
-        node->evaluation = new_evaluation;
-        propagate_evaluation_to_transpositions(node);
+        FREE_MEMORY(old_buckets);
     }
 }
 
-void get_moves(Position*position)
+bool archive_position(CompressedPosition*position, uint64_t zobrist_key)
 {
-    PositionTreeNode*node = GET_POSITION_TREE_NODE(position->node_index);
-    if (setjmp(out_of_memory_jump_buffer))
-    {
-        if (!node->is_leaf)
-        {
-            SET_FIRST_MOVE_NODE_INDEX(node, NULL_POSITION_TREE_NODE);
-            node->is_leaf = true;
-        }
-        return;
-    }
-    uint8_t player_pieces_index = PLAYER_PIECES_INDEX(position->active_player_index);
-    uint8_t max_piece_index = player_pieces_index + 16;
-    for (uint8_t piece_index = player_pieces_index; piece_index < max_piece_index; ++piece_index)
+    PositionRecord*record =
+        g_position_records + (zobrist_key & (g_position_record_bucket_count - 1));
+    if (record->count && record->generation == g_played_position_generation)
     {
-        Piece piece = position->pieces[piece_index];
-        if (piece.square_index == NULL_SQUARE)
-        {
-            continue;
-        }
-        switch (piece.piece_type)
-        {
-        case PIECE_BISHOP:
-        {
-            add_diagonal_moves(position, piece_index);
-            break;
-        }
-        case PIECE_KING:
-        {
-            uint8_t castling_rights_lost = 0b11 << (position->active_player_index << 1);
-            bool reset_draw_by_50_count = castling_rights_lost != position->castling_rights_lost;
-            uint8_t move_ranks[3];
-            size_t move_rank_count =
-                add_king_move_ranks_or_files(move_ranks, RANK(piece.square_index));
-            uint8_t move_files[3];
-            size_t move_file_count =
-                add_king_move_ranks_or_files(move_files, FILE(piece.square_index));
-            for (size_t rank_index = 0; rank_index < move_rank_count; ++rank_index)
-            {
-                for (size_t file_index = 0; file_index < move_file_count; ++file_index)
-                {
-                    int8_t control_counts[64];
-                    Position move;
-                    switch (attempt_piece_move(position, &move, control_counts, piece_index,
-                        SQUARE_INDEX(move_ranks[rank_index], move_files[file_index])))
-                    {
-                    case MOVE_ATTEMPT_MOVE:
-                    case MOVE_ATTEMPT_CAPTURE:
-                    {
-                        move.castling_rights_lost |= castling_rights_lost;
-                        move.reset_draw_by_50_count |= reset_draw_by_50_count;
-                        add_move(position, &move,
-                            get_king_safety_evaluation(&move, control_counts));
-                    }
-                    }
-                }
-            }
-            if (!(position->castling_rights_lost &
-                (1 << (position->active_player_index << 1))) &&
-                position->squares[piece.square_index - 1] == NULL_PIECE &&
-                position->squares[piece.square_index - 2] == NULL_PIECE &&
-                position->squares[piece.square_index - 3] == NULL_PIECE)
-            {
-                Position move;
-                copy_position(position, &move);
-                move_piece(&move, piece_index, piece.square_index - 2);
-                move_piece(&move, position->squares[piece.square_index - 4],
-                    piece.square_index - 1);
-                int8_t control_counts[64] = { 0 };
-                increment_square_control_counts(&move, control_counts, move.active_player_index);
-                if (!control_counts[piece.square_index] &&
-                    !control_counts[piece.square_index - 1] &&
-                    !control_counts[piece.square_index - 2])
-                {
-                    move.castling_rights_lost |= castling_rights_lost;
-                    move.reset_draw_by_50_count = true;
-                    add_move(position, &move, get_king_safety_evaluation(&move, control_counts));
-                }
-            }
-            if (!(position->castling_rights_lost &
-                (0b10 << (position->active_player_index << 1))) &&
-                position->squares[piece.square_index + 1] == NULL_PIECE &&
-                position->squares[piece.square_index + 2] == NULL_PIECE)
-            {
-                Position move;
-                copy_position(position, &move);
-                move_piece(&move, piece_index, piece.square_index + 2);
-                move_piece(&move, position->squares[piece.square_index + 3],
-                    piece.square_index + 1);
-                int8_t control_counts[64] = { 0 };
-                increment_square_control_counts(&move, control_counts, move.active_player_index);
-                if (!control_counts[piece.square_index] &&
-                    !control_counts[piece.square_index + 1] &&
-                    !control_counts[piece.square_index + 2])
-                {
-                    move.castling_rights_lost |= castling_rights_lost;
-                    move.reset_draw_by_50_count = true;
-                    add_move(position, &move, get_king_safety_evaluation(&move, control_counts));
-                }
-            }
-            break;
-        }
-        case PIECE_KNIGHT:
-        {
-            uint8_t destination_square_indices[8];
-            size_t square_count = add_knight_destination_square_indices(destination_square_indices,
-                piece.square_index);
-            for (size_t i = 0; i < square_count; ++i)
-            {
-                move_piece_and_add_as_move(position, piece_index, destination_square_indices[i]);
-            }
-            break;
-        }
-        case PIECE_PAWN:
-        {
-            int8_t forward_delta = FORWARD_DELTA(position->active_player_index);
-            uint8_t file = FILE(piece.square_index);
-            if (file)
-            {
-                add_diagonal_pawn_move(position, piece_index, file - 1);
-            }
-            if (file < 7)
-            {
-                add_diagonal_pawn_move(position, piece_index, file + 1);
-            }
-            uint8_t destination_square_index = piece.square_index + forward_delta * FILE_COUNT;
-            if (position->squares[destination_square_index] == NULL_PIECE)
-            {
-                Position move;
-                copy_position(position, &move);
-                move_piece(&move, piece_index, destination_square_index);
-                move.reset_draw_by_50_count = true;
-                destination_square_index += forward_delta * FILE_COUNT;
-                add_pawn_move_with_promotions(position, &move, piece_index);
-                if (position->squares[destination_square_index] == NULL_PIECE &&
-                    RANK(piece.square_index) == KING_RANK(position->active_player_index) +
-                        forward_delta)
-                {
-                    copy_position(position, &move);
-                    move_piece(&move, piece_index, destination_square_index);
-                    move.reset_draw_by_50_count = true;
-                    move.en_passant_file = file;
-                    add_move_if_not_king_hang(position, &move);
-                }
-            }
-            break;
-        }
-        case PIECE_QUEEN:
-        {
-            add_diagonal_moves(position, piece_index);
-            add_moves_along_axes(position, piece_index, 0);
-            break;
-        }
-        case PIECE_ROOK:
+        while (record->zobrist_key != zobrist_key ||
+            memcmp(position, &record->position, sizeof(CompressedPosition)))
         {
-            uint8_t castling_right_lost;
-            uint8_t file = FILE(piece.square_index);
-            switch (file)
-            {
-            case 0:
-            {
-                castling_right_lost = 1 << (position->active_player_index << 1);
-                break;
-            }
-            case 7:
+            if (record->index_of_next_record == NULL_PLAYED_POSITION_RECORD)
             {
-                castling_right_lost = 1 << ((position->active_player_index << 1) + 1);
-                break;
+                record->index_of_next_record = g_external_position_record_count;
+                EXTERNAL_POSITION_RECORDS()[g_external_position_record_count] =
+                    (PositionRecord) { *position, zobrist_key, NULL_PLAYED_POSITION_RECORD, 1,
+                        g_played_position_generation };
+                ++g_external_position_record_count;
+                increment_unique_position_count();
+                return true;
             }
-            default:
+            else
             {
-                castling_right_lost = 0;
-            }
+                record = EXTERNAL_POSITION_RECORDS() + record->index_of_next_record;
             }
-            add_moves_along_axes(position, piece_index, castling_right_lost);
-        }
-        }
-    }
-    node->moves_have_been_found = true;
-    int16_t new_evaluation;
-    if (node->is_leaf)
-    {
-        int8_t control_counts[64] = { 0 };
-        increment_square_control_counts(position, control_counts, !position->active_player_index);
-        if (control_counts
-            [position->pieces[PLAYER_PIECES_INDEX(position->active_player_index)].square_index])
-        {
-            new_evaluation = PLAYER_WIN(!position->active_player_index);
         }
-        else
+        ++record->count;
+        if (record->count == 3)
         {
-            new_evaluation = 0;
+            return false;
         }
     }
     else
     {
-        new_evaluation = PLAYER_WIN(!position->active_player_index);
-        uint16_t move_node_index = GET_FIRST_MOVE_NODE_INDEX(node);
-        PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
-        while (true)
-        {
-            if (move_node->is_canonical)
-            {
-                Position move;
-                decompress_position(&move, move_node_index);
-                for (size_t player_index = 0; player_index < 2; ++player_index)
-                {
-                    int16_t point = 32 * FORWARD_DELTA(!player_index);
-                    Piece*player_pieces = move.pieces + PLAYER_PIECES_INDEX(player_index);
-                    for (size_t piece_index = 0; piece_index < 16; ++piece_index)
-                    {
-                        Piece piece = player_pieces[piece_index];
-                        if (piece.square_index < NULL_SQUARE)
-                        {
-                            switch (piece.piece_type)
-                            {
-                            case PIECE_PAWN:
-                            {
-                                move_node->evaluation += point;
-                                break;
-                            }
-                            case PIECE_BISHOP:
-                            case PIECE_KNIGHT:
-                            {
-                                move_node->evaluation += 3 * point;
-                                break;
-                            }
-                            case PIECE_ROOK:
-                            {
-                                move_node->evaluation += 5 * point;
-                                break;
-                            }
-                            case PIECE_QUEEN:
-                            {
-                                move_node->evaluation += 9 * point;
-                            }
-                            }
-                        }
-                    }
-                }
-            }
-            if (position->active_player_index == PLAYER_INDEX_WHITE)
-            {
-                if (move_node->evaluation > new_evaluation)
-                {
-                    new_evaluation = move_node->evaluation;
-                }
-            }
-            else if (move_node->evaluation < new_evaluation)
-            {
-                new_evaluation = move_node->evaluation;
-            }
-            if (move_node->next_move_node_index == NULL_POSITION_TREE_NODE)
-            {
-                break;
-            }
-            move_node_index = move_node->next_move_node_index;
-            move_node = GET_POSITION_TREE_NODE(move_node_index);
-        }
-    }
-    if (new_evaluation == node->evaluation)
-    {
-        return;
+        record->position = *position;
+        record->zobrist_key = zobrist_key;
+        record->index_of_next_record = NULL_PLAYED_POSITION_RECORD;
+        record->count = 1;
+        record->generation = g_played_position_generation;
+        increment_unique_position_count();
     }
-    node->evaluation = new_evaluation;
-    propagate_evaluation_to_transpositions(node);
-    propagate_evaluation_to_parents(node);
+    return true;
 }
 
 bool point_is_in_rect(int32_t x, int32_t y, int32_t min_x, int32_t min_y, uint32_t width,
@@ -1683,31 +503,6 @@ UpdateTimerStatus update_timer(void)
     return out;
 }
 
-bool make_position_current(void)
-{
-    for (size_t i = 0; i < ARRAY_COUNT(g_tree_position_buckets); ++i)
-    {
-        g_tree_position_buckets[i] = NULL_POSITION_TREE_NODE;
-    }
-    g_index_of_first_free_position_tree_node = 1;
-    Position*position = g_current_position + g_active_player_index;
-    position->node_index = 0;
-    g_position_tree_nodes->is_leaf = true;
-    g_position_tree_nodes->moves_have_been_found = false;
-    g_position_tree_nodes->is_canonical = true;
-    g_position_tree_nodes->evaluation_has_been_propagated_to_parents = true;
-    compress_position_to_node(position, 0);
-    g_position_tree_nodes->parent_index = NULL_POSITION_TREE_NODE;
-    SET_PREVIOUS_LEAF_INDEX(g_position_tree_nodes, NULL_POSITION_TREE_NODE);
-    SET_NEXT_LEAF_INDEX(g_position_tree_nodes, NULL_POSITION_TREE_NODE);
-    g_position_tree_nodes->next_move_node_index = NULL_POSITION_TREE_NODE;
-    g_first_leaf_index = 0;
-    get_moves(position);
-    g_next_leaf_to_evaluate_index = g_first_leaf_index;
-    g_selected_piece_index = NULL_PIECE;
-    return archive_position(&g_position_tree_nodes->position);
-}
-
 typedef enum GUIAction
 {
     ACTION_CHECKMATE,
@@ -1741,7 +536,7 @@ GUIAction end_turn(void)
     }
     g_seconds_left[g_active_player_index] = *time_left_as_of_last_move / g_counts_per_second;
     g_last_move_time = move_time;
-    EXPORT_POSITION_TREE();
+    ++g_played_ply_count;
     g_selected_piece_index = NULL_PIECE;
     uint8_t*player_captured_piece_counts = g_captured_piece_counts[!g_active_player_index];
     uint8_t player_pieces_index = PLAYER_PIECES_INDEX(!g_active_player_index);
@@ -1757,7 +552,7 @@ GUIAction end_turn(void)
     }
     g_active_player_index = !g_active_player_index;
     current_position = g_current_position + g_active_player_index;
-    decompress_position(current_position, g_selected_move_node_index);
+    *current_position = g_legal_moves[g_selected_move_index];
     for (uint8_t piece_index = player_pieces_index; piece_index < max_piece_index; ++piece_index)
     {
         Piece piece = current_position->pieces[piece_index];
@@ -1766,107 +561,62 @@ GUIAction end_turn(void)
             --player_captured_piece_counts[current_position->pieces[piece_index].piece_type];
         }
     }
-    PositionTreeNode*selected_move_node = g_position_tree_nodes + g_selected_move_node_index;
-    g_position_tree_nodes->evaluation = selected_move_node->evaluation;
-    g_position_tree_nodes->reset_draw_by_50_count = selected_move_node->reset_draw_by_50_count;
     if (current_position->reset_draw_by_50_count)
     {
         g_draw_by_50_count = 0;
         ++g_played_position_generation;
     }
-    if (make_position_current())
-    {
-        if (g_position_tree_nodes->is_leaf)
-        {
-            if (g_position_tree_nodes->evaluation == PLAYER_WIN(!g_active_player_index))
-            {
-                g_run_engine = false;
-                return ACTION_CHECKMATE;
-            }
-            else
-            {
-                g_run_engine = false;
-                return ACTION_STALEMATE;
-            }
-        }
-        ++g_draw_by_50_count;
-        g_run_engine = g_active_player_index == g_engine_player_index;
-        return ACTION_REDRAW;
-    }
-    else
+    CompressedPosition compressed_position;
+    compress_position(&compressed_position, current_position);
+    if (!archive_position(&compressed_position, current_position->zobrist_key))
     {
-        g_run_engine = false;
         return ACTION_REPETITION_DRAW;
     }
+    ++g_draw_by_50_count;
+    g_legal_move_count = 0;
+    send_engine_command(&(EngineCommand) { .type = ENGINE_COMMAND_PLAY_MOVE,
+        .move_index = g_selected_move_index });
+    return ACTION_REDRAW;
 }
 
-GUIAction do_engine_iteration(void)
+GUIAction handle_engine_result(void)
 {
-    if (g_run_engine)
+    EngineResult result;
+    if (!poll_engine_result(&result))
     {
-        uint16_t first_leaf_checked_index = g_next_leaf_to_evaluate_index;
-        uint16_t node_to_evaluate_index = g_next_leaf_to_evaluate_index;
-        PositionTreeNode*node;
-        while (true)
-        {
-            if (node_to_evaluate_index == NULL_POSITION_TREE_NODE)
-            {
-                node_to_evaluate_index = g_first_leaf_index;
-            }
-            node = GET_POSITION_TREE_NODE(node_to_evaluate_index);
-            if (node->is_canonical)
-            {
-                if (!node->moves_have_been_found)
-                {
-                    g_next_leaf_to_evaluate_index = GET_NEXT_LEAF_INDEX(node);
-                    Position position;
-                    decompress_position(&position, node_to_evaluate_index);
-                    get_moves(&position);
-                    break;
-                }
-            }
-            else if (!node->evaluation_has_been_propagated_to_parents)
-            {
-                propagate_evaluation_to_parents(node);
-            }
-            if (first_leaf_checked_index == GET_NEXT_LEAF_INDEX(node))
-            {
-                g_run_engine = false;
-                break;
-            }
-            node_to_evaluate_index = GET_NEXT_LEAF_INDEX(node);
-        }
+        return ACTION_NONE;
+    }
+    switch (result.type)
+    {
+    case ENGINE_RESULT_BEST_MOVE:
+    {
+        g_selected_move_index = result.move_index;
+        return end_turn();
+    }
+    case ENGINE_RESULT_CHECKMATE:
+    {
+        return ACTION_CHECKMATE;
     }
-    if (!g_run_engine)
+    case ENGINE_RESULT_STALEMATE:
+    {
+        return ACTION_STALEMATE;
+    }
+    default:
     {
         if (g_active_player_index == g_engine_player_index)
         {
-            int64_t best_evaluation = PLAYER_WIN(!g_engine_player_index);
-            ASSERT(!g_position_tree_nodes->is_leaf);
-            uint16_t move_node_index = g_position_tree_nodes->first_move_node_index;
-            g_selected_move_node_index = move_node_index;
-            while (move_node_index != NULL_POSITION_TREE_NODE)
-            {
-                PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
-                if (g_engine_player_index == PLAYER_INDEX_WHITE)
-                {
-                    if (move_node->evaluation > best_evaluation)
-                    {
-                        best_evaluation = move_node->evaluation;
-                        g_selected_move_node_index = move_node_index;
-                    }
-                }
-                else if (move_node->evaluation < best_evaluation)
-                {
-                    best_evaluation = move_node->evaluation;
-                    g_selected_move_node_index = move_node_index;
-                }
-                move_node_index = move_node->next_move_node_index;
-            }
-            return end_turn();
+            send_engine_command(&(EngineCommand) { .type = ENGINE_COMMAND_START,
+                .clock = { .time_left = g_times_left_as_of_last_move[g_engine_player_index],
+                    .time_increment = g_time_increment, .turn_start_time = g_last_move_time,
+                    .played_ply_count = g_played_ply_count } });
+        }
+        else if (g_ponder)
+        {
+            send_engine_command(&(EngineCommand) { .type = ENGINE_COMMAND_PONDER });
         }
+        return ACTION_REDRAW;
+    }
     }
-    return ACTION_NONE;
 }
 
 Color g_black = { .value = 0xff000000 };
@@ -2769,20 +1519,17 @@ GUIAction main_window_handle_left_mouse_button_up(int32_t cursor_x, int32_t curs
             uint8_t selected_piece_index = current_position->squares[square_index];
             if (PLAYER_INDEX(selected_piece_index) == g_active_player_index)
             {
-                g_selected_move_node_index = g_position_tree_nodes->first_move_node_index;
-                while (g_selected_move_node_index != NULL_POSITION_TREE_NODE)
+                for (g_selected_move_index = 0; g_selected_move_index < g_legal_move_count;
+                    ++g_selected_move_index)
                 {
-                    Position move;
-                    decompress_position(&move, g_selected_move_node_index);
-                    uint8_t source_square = move.squares[square_index];
-                    if (source_square == NULL_PIECE || move.pieces[source_square].piece_type !=
+                    Position*move = g_legal_moves + g_selected_move_index;
+                    uint8_t source_square = move->squares[square_index];
+                    if (source_square == NULL_PIECE || move->pieces[source_square].piece_type !=
                         current_position->pieces[selected_piece_index].piece_type)
                     {
                         g_selected_piece_index = selected_piece_index;
                         return ACTION_REDRAW;
                     }
-                    g_selected_move_node_index =
-                        GET_POSITION_TREE_NODE(g_selected_move_node_index)->next_move_node_index;
                 }
             }
         }
@@ -2795,14 +1542,10 @@ GUIAction main_window_handle_left_mouse_button_up(int32_t cursor_x, int32_t curs
             {
                 PieceType selected_piece_type =
                     g_promotion_options[id - promotion_selector_base_id];
-                Position move;
-                decompress_position(&move, g_selected_move_node_index);
-                PositionTreeNode*move_node = GET_POSITION_TREE_NODE(g_selected_move_node_index);
-                while (move.pieces[g_selected_piece_index].piece_type != selected_piece_type)
+                while (g_legal_moves[g_selected_move_index].pieces[g_selected_piece_index].
+                    piece_type != selected_piece_type)
                 {
-                    g_selected_move_node_index = move_node->next_move_node_index;
-                    decompress_position(&move, move_node->next_move_node_index);
-                    move_node = GET_POSITION_TREE_NODE(move_node->next_move_node_index);
+                    ++g_selected_move_index;
                 }
                 end_turn();
                 g_is_promoting = false;
@@ -2816,23 +1559,23 @@ GUIAction main_window_handle_left_mouse_button_up(int32_t cursor_x, int32_t curs
                     SCREEN_SQUARE_INDEX(id - window->controls[MAIN_WINDOW_BOARD].base_id);
                 if (PLAYER_INDEX(current_position->squares[square_index]) != g_active_player_index)
                 {
-                    uint16_t piece_first_move_node_index = g_selected_move_node_index;
+                    uint8_t piece_first_move_index = g_selected_move_index;
                     do
                     {
-                        Position move;
-                        decompress_position(&move, g_selected_move_node_index);
+                        Position*move = g_legal_moves + g_selected_move_index;
                         uint8_t move_source_square =
-                            move.squares[current_position_selected_piece.square_index];
+                            move->squares[current_position_selected_piece.square_index];
                         if (PLAYER_INDEX(move_source_square) == g_active_player_index &&
-                            move.pieces[move_source_square].piece_type ==
+                            move->pieces[move_source_square].piece_type ==
                             current_position_selected_piece.piece_type)
                         {
                             break;
                         }
-                        uint8_t destination_square = move.squares[square_index];
+                        uint8_t destination_square = move->squares[square_index];
                         if (PLAYER_INDEX(destination_square) == g_active_player_index)
                         {
-                            PieceType moved_piece_type = move.pieces[destination_square].piece_type;
+                            PieceType moved_piece_type =
+                                move->pieces[destination_square].piece_type;
                             if (moved_piece_type == current_position_selected_piece.piece_type)
                             {
                                 return end_turn();
@@ -2843,11 +1586,9 @@ GUIAction main_window_handle_left_mouse_button_up(int32_t cursor_x, int32_t curs
                                 return ACTION_REDRAW;
                             }
                         }
-                        g_selected_move_node_index =
-                            GET_POSITION_TREE_NODE(g_selected_move_node_index)->
-                                next_move_node_index;
-                    } while (g_selected_move_node_index != NULL_POSITION_TREE_NODE);
-                    g_selected_move_node_index = piece_first_move_node_index;
+                        ++g_selected_move_index;
+                    } while (g_selected_move_index < g_legal_move_count);
+                    g_selected_move_index = piece_first_move_index;
                 }
             }
         }
@@ -3166,8 +1907,9 @@ bool load_game(void*file_memory, uint32_t file_size)
     {
         return false;
     }
-    load_compressed_position(&file_memory, &g_position_tree_nodes->position, &file_size);
-    g_active_player_index = g_position_tree_nodes->position.active_player_index;
+    CompressedPosition current_position;
+    load_compressed_position(&file_memory, &current_position, &file_size);
+    g_active_player_index = current_position.active_player_index;
     if (!load_value(&file_memory, &g_times_left_as_of_last_move[0], &file_size,
         sizeof(g_times_left_as_of_last_move[0])))
     {
@@ -3208,34 +1950,31 @@ bool load_game(void*file_memory, uint32_t file_size)
     {
         CompressedPosition position;
         load_compressed_position(&file_memory, &position, &file_size);
-        archive_position(&position);
+        Position unpacked_position;
+        unpack_position(&unpacked_position, &position);
+        archive_position(&position, unpacked_position.zobrist_key);
     }
     Position*position = g_current_position + g_active_player_index;
-    decompress_position(position, 0);
-    make_position_current();
+    unpack_position(position, &current_position);
+    archive_position(&current_position, position->zobrist_key);
+    send_engine_command(&(EngineCommand) { .type = ENGINE_COMMAND_SET_POSITION,
+        .position = *position });
+    g_selected_piece_index = NULL_PIECE;
     g_seconds_left[g_active_player_index] = (g_times_left_as_of_last_move[g_active_player_index] -
         time_since_last_move) / g_counts_per_second;
     g_seconds_left[!g_active_player_index] =
         g_times_left_as_of_last_move[!g_active_player_index] / g_counts_per_second;
     g_last_move_time = get_time() - time_since_last_move;
-    g_run_engine = g_active_player_index == g_engine_player_index;
+    g_played_ply_count = g_unique_played_position_count;
     return true;
 }
 
-void init_piece(Position*position, PieceType piece_type, uint8_t piece_index, uint8_t square_index,
-    uint8_t player_index)
-{
-    piece_index += PLAYER_PIECES_INDEX(player_index);
-    Piece*piece = position->pieces + piece_index;
-    piece->square_index = square_index;
-    piece->piece_type = piece_type;
-    position->squares[square_index] = piece_index;
-}
-
 void init_new_game(void)
 {
     g_active_player_index = PLAYER_INDEX_WHITE;
     Position*current_position = g_current_position + PLAYER_INDEX_WHITE;
+    memset(current_position->piece_type_masks, 0, sizeof(current_position->piece_type_masks));
+    memset(current_position->player_masks, 0, sizeof(current_position->player_masks));
     for (uint8_t player_index = 0; player_index < 2; ++player_index)
     {
         uint8_t player_pieces_index = PLAYER_PIECES_INDEX(player_index);
@@ -3263,13 +2002,20 @@ void init_new_game(void)
         current_position->squares[square_index] = NULL_PIECE;
     }
     current_position->en_passant_file = FILE_COUNT;
+    init_square_control_counts(current_position);
+    init_zobrist_key(current_position);
     init_position_archive(32);
-    make_position_current();
+    CompressedPosition compressed_position;
+    compress_position(&compressed_position, current_position);
+    archive_position(&compressed_position, current_position->zobrist_key);
+    send_engine_command(&(EngineCommand) { .type = ENGINE_COMMAND_SET_POSITION,
+        .position = *current_position });
+    g_selected_piece_index = NULL_PIECE;
     Window*window = g_windows + WINDOW_MAIN;
     window->hovered_control_id = NULL_CONTROL;
     window->clicked_control_id = NULL_CONTROL;
     g_draw_by_50_count = 0;
-    g_run_engine = g_active_player_index == g_engine_player_index;
+    g_played_ply_count = 0;
     g_is_promoting = false;
     memset(g_captured_piece_counts, 0, sizeof(g_captured_piece_counts));
     g_times_left_as_of_last_move[0] = g_counts_per_second * g_seconds_left[0];
@@ -3279,12 +2025,18 @@ void init_new_game(void)
     g_last_move_time = get_time();
 }
 
-void init(void*font_data, size_t text_font_data_size, size_t icon_font_data_size)
+bool init(void*font_data, size_t text_font_data_size, size_t icon_font_data_size)
 {
     FT_Init_FreeType(&g_freetype_library);
     FT_New_Memory_Face(g_freetype_library, font_data, text_font_data_size, 0, &g_text_face);
     FT_New_Memory_Face(g_freetype_library, (void*)((uintptr_t)font_data + text_font_data_size),
         text_font_data_size, 0, &g_icon_face);
+    init_attack_tables();
+    init_zobrist_keys();
+    if (!init_engine())
+    {
+        return false;
+    }
     g_windows[WINDOW_START].controls = g_dialog_controls;
     for (size_t i = 0; i < ARRAY_COUNT(g_dpi_datas); ++i)
     {
@@ -3315,5 +2067,5 @@ void init(void*font_data, size_t text_font_data_size, size_t icon_font_data_size
     ++digit;
     digit->digit = 5;
     digit->is_before_colon = false;
-    g_run_engine = false;
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,3919 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include "platform_dependency.c"
+
+#define ARRAY_COUNT(arr) (sizeof(arr) / sizeof(arr[0]))
+
+#ifndef POSITION_TREE_STORAGE
+#define POSITION_TREE_STORAGE
+#endif
+
+#ifndef EXPORT_POSITION_TREE
+#define EXPORT_POSITION_TREE()
+#endif
+
+typedef enum PieceType
+{
+    PIECE_BISHOP,
+    PIECE_KING,
+    PIECE_KNIGHT,
+    PIECE_QUEEN,
+    PIECE_ROOK,
+    PIECE_PAWN,
+    PIECE_TYPE_COUNT
+} PieceType; 
+
+PieceType g_promotion_options[] = { PIECE_QUEEN, PIECE_ROOK, PIECE_BISHOP, PIECE_KNIGHT };
+
+int16_t g_piece_values[PIECE_TYPE_COUNT] = { [PIECE_BISHOP] = 3,[PIECE_KING] = 0,
+[PIECE_KNIGHT] = 3,[PIECE_QUEEN] = 9,[PIECE_ROOK] = 5,[PIECE_PAWN] = 1 };
+
+typedef struct Piece
+{
+    uint8_t square_index;
+    uint8_t piece_type;
+} Piece;
+
+#define RANK_COUNT 8
+#define FILE_COUNT 8
+
+#ifdef SIXTEEN_BIT_POSITION_TREE_NODE_INDICES
+typedef uint16_t NodeIndex;
+#define NULL_POSITION_TREE_NODE UINT16_MAX
+#else
+typedef uint32_t NodeIndex;
+#define NULL_POSITION_TREE_NODE UINT32_MAX
+#endif
+
+typedef struct Position
+{
+    uint64_t piece_type_masks[PIECE_TYPE_COUNT];
+    uint64_t player_masks[2];
+    uint64_t zobrist_key;
+    int8_t square_control_counts[2][RANK_COUNT * FILE_COUNT];
+    uint8_t squares[RANK_COUNT * FILE_COUNT];
+    Piece pieces[32];
+    NodeIndex node_index;
+    uint8_t en_passant_file;
+    uint8_t castling_rights_lost;
+    uint8_t active_player_index;
+    bool reset_draw_by_50_count;
+} Position;
+
+typedef enum MoveFlag
+{
+    MOVE_FLAG_NORMAL,
+    MOVE_FLAG_DOUBLE_PUSH,
+    MOVE_FLAG_CASTLE,
+    MOVE_FLAG_EN_PASSANT,
+    MOVE_FLAG_PROMOTION
+} MoveFlag;
+
+typedef uint16_t Move;
+
+typedef struct MoveUndo
+{
+    uint8_t captured_piece_index;
+    uint8_t en_passant_file;
+    uint8_t castling_rights_lost;
+    bool reset_draw_by_50_count;
+} MoveUndo;
+
+typedef enum MoveStage
+{
+    MOVE_STAGE_CAPTURES,
+    MOVE_STAGE_CHECKS,
+    MOVE_STAGE_QUIETS,
+    MOVE_STAGE_DONE
+} MoveStage;
+
+typedef struct CompressedPosition
+{
+    uint8_t square_mask[8];
+    uint8_t piece_hashes[16];
+    uint8_t en_passant_file;
+    uint8_t castling_rights_lost : 4;
+    uint8_t active_player_index : 1;
+} CompressedPosition;
+
+typedef struct PositionTreeNode
+{
+    int16_t evaluation;
+    NodeIndex parent_index;
+    uint32_t position_hash;
+    int16_t best_skipped_move_evaluation;
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+    Move move;
+#else
+    CompressedPosition position;
+#endif
+    union
+    {
+        struct
+        {
+            NodeIndex previous_leaf_index;
+            NodeIndex next_leaf_index;
+        };
+        struct
+        {
+            NodeIndex first_move_node_index;
+            NodeIndex best_move_node_index;
+        };
+    };
+    NodeIndex next_move_node_index;
+    NodeIndex next_transposion_index;
+    union
+    {
+        NodeIndex index_of_next_position_with_same_hash;
+        NodeIndex next_pending_transposition_index;
+    };
+    bool is_leaf;
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+    uint8_t active_player_index;
+#endif
+    bool reset_draw_by_50_count : 1;
+    bool is_canonical : 1;
+    bool evaluation_has_been_propagated_to_parents : 1;
+    uint8_t next_move_stage : 2;
+    bool has_skipped_moves : 1;
+    bool is_claimed : 1;
+    bool is_queued : 1;
+} PositionTreeNode;
+
+typedef struct FrontierEntry
+{
+    uint32_t priority;
+    NodeIndex node_index;
+} FrontierEntry;
+
+typedef struct ProofNumbers
+{
+    uint32_t proof_number;
+    uint32_t disproof_number;
+} ProofNumbers;
+
+typedef enum SearchMode
+{
+    SEARCH_MODE_TREE,
+    SEARCH_MODE_ALPHA_BETA,
+    SEARCH_MODE_ROOT_SPLIT,
+    SEARCH_MODE_PROOF_NUMBER
+} SearchMode;
+
+#define MAX_MOVE_COUNT 256
+#define NULL_PIECE 32
+#define NULL_SQUARE 64
+#define PLAYER_INDEX_WHITE 0
+#define PLAYER_INDEX_BLACK 1
+#define DEFAULT_POSITION_TREE_BYTE_COUNT ((uint64_t)1 << 30)
+#define POSITION_TREE_COMMIT_NODE_COUNT 65536
+#define MIN_POSITION_TREE_NODE_CAPACITY (2 * MAX_MOVE_COUNT)
+#define FRONTIER_PLY_PRIORITY 256
+#define QUIESCENCE_DELTA_MARGIN 64
+#define PROOF_NUMBER_INFINITY UINT32_MAX
+#define PROOF_NUMBER_UNKNOWN (PROOF_NUMBER_INFINITY - 1)
+
+POSITION_TREE_STORAGE PositionTreeNode*g_position_tree_nodes;
+POSITION_TREE_STORAGE NodeIndex*g_tree_position_buckets;
+POSITION_TREE_STORAGE NodeIndex g_first_leaf_index;
+POSITION_TREE_STORAGE NodeIndex g_index_of_first_free_position_tree_node;
+POSITION_TREE_STORAGE NodeIndex*g_new_position_tree_node_indices;
+POSITION_TREE_STORAGE FrontierEntry*g_frontier;
+POSITION_TREE_STORAGE ProofNumbers*g_proof_numbers;
+POSITION_TREE_STORAGE NodeIndex g_frontier_size;
+POSITION_TREE_STORAGE NodeIndex g_first_pending_transposition_index = NULL_POSITION_TREE_NODE;
+POSITION_TREE_STORAGE NodeIndex g_position_tree_node_capacity;
+POSITION_TREE_STORAGE NodeIndex g_committed_position_tree_node_count;
+POSITION_TREE_STORAGE uint8_t g_tree_position_bucket_index_bit_count;
+uint64_t g_position_tree_byte_count = DEFAULT_POSITION_TREE_BYTE_COUNT;
+uint16_t g_skipped_move_margin;
+bool g_run_engine;
+
+#ifdef ALPHA_BETA_SEARCH
+SearchMode g_search_mode = SEARCH_MODE_ALPHA_BETA;
+#else
+SearchMode g_search_mode = SEARCH_MODE_TREE;
+#endif
+
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+POSITION_TREE_STORAGE Position g_position_tree_root;
+POSITION_TREE_STORAGE Position g_replayed_position;
+POSITION_TREE_STORAGE Move*g_replayed_moves;
+POSITION_TREE_STORAGE NodeIndex g_replayed_position_node_index = NULL_POSITION_TREE_NODE;
+#endif
+
+#ifdef DEBUG
+#define ASSERT(condition) if (!(condition)) *((int*)0) = 0
+
+PositionTreeNode*get_position_tree_node(NodeIndex node_index)
+{
+    ASSERT(node_index != NULL_POSITION_TREE_NODE);
+    return g_position_tree_nodes + node_index;
+}
+
+NodeIndex get_previous_leaf_index(PositionTreeNode*node)
+{
+    ASSERT(node->is_leaf);
+    return node->previous_leaf_index;
+}
+
+NodeIndex get_next_leaf_index(PositionTreeNode*node)
+{
+    ASSERT(node->is_leaf);
+    return node->next_leaf_index;
+}
+
+NodeIndex get_first_move_node_index(PositionTreeNode*node)
+{
+    ASSERT(!node->is_leaf);
+    return node->first_move_node_index;
+}
+
+NodeIndex get_cached_best_move_node_index(PositionTreeNode*node)
+{
+    ASSERT(!node->is_leaf);
+    return node->best_move_node_index;
+}
+
+void set_previous_leaf_index(PositionTreeNode*node, NodeIndex value)
+{
+    ASSERT(node->is_leaf);
+    node->previous_leaf_index = value;
+}
+
+void set_next_leaf_index(PositionTreeNode*node, NodeIndex value)
+{
+    ASSERT(node->is_leaf);
+    node->next_leaf_index = value;
+}
+
+void set_first_move_node_index(PositionTreeNode*node, NodeIndex value)
+{
+    ASSERT(!node->is_leaf);
+    node->first_move_node_index = value;
+}
+
+void set_cached_best_move_node_index(PositionTreeNode*node, NodeIndex value)
+{
+    ASSERT(!node->is_leaf);
+    node->best_move_node_index = value;
+}
+
+#define GET_POSITION_TREE_NODE(node_index) get_position_tree_node(node_index)
+#define GET_PREVIOUS_LEAF_INDEX(node) get_previous_leaf_index(node)
+#define GET_NEXT_LEAF_INDEX(position_tree_node) get_next_leaf_index(position_tree_node)
+#define GET_FIRST_MOVE_NODE_INDEX(node) get_first_move_node_index(node)
+#define SET_PREVIOUS_LEAF_INDEX(position_tree_node, value) set_previous_leaf_index(position_tree_node, value)
+#define SET_NEXT_LEAF_INDEX(position_tree_node, value) set_next_leaf_index(position_tree_node, value)
+#define SET_FIRST_MOVE_NODE_INDEX(node, value) set_first_move_node_index(node, value)
+#define GET_BEST_MOVE_NODE_INDEX(node) get_cached_best_move_node_index(node)
+#define SET_BEST_MOVE_NODE_INDEX(node, value) set_cached_best_move_node_index(node, value)
+#else
+#define ASSERT(condition)
+#define GET_POSITION_TREE_NODE(node_index) (g_position_tree_nodes + (node_index))
+#define GET_PREVIOUS_LEAF_INDEX(position_tree_node) (position_tree_node)->previous_leaf_index
+#define GET_NEXT_LEAF_INDEX(position_tree_node) (position_tree_node)->next_leaf_index
+#define GET_FIRST_MOVE_NODE_INDEX(node) (node)->first_move_node_index
+#define SET_PREVIOUS_LEAF_INDEX(position_tree_node, value) ((position_tree_node)->previous_leaf_index = (value))
+#define SET_NEXT_LEAF_INDEX(position_tree_node, value) ((position_tree_node)->next_leaf_index = (value))
+#define SET_FIRST_MOVE_NODE_INDEX(node, value) ((node)->first_move_node_index = (value))
+#define GET_BEST_MOVE_NODE_INDEX(node) (node)->best_move_node_index
+#define SET_BEST_MOVE_NODE_INDEX(node, value) ((node)->best_move_node_index = (value))
+#endif
+
+#define PLAYER_INDEX(piece_index) ((piece_index) >> 4)
+#define KING_RANK(player_index) (7 * !(player_index))
+#define FORWARD_DELTA(player_index) (((player_index) << 1) - 1)
+#define RANK(square_index) ((square_index) >> 3)
+#define FILE(square_index) ((square_index) & 0b111)
+#define SQUARE_INDEX(rank, file) (FILE_COUNT * (rank) + (file))
+#define PLAYER_PIECES_INDEX(player_index) ((player_index) << 4)
+#define EN_PASSANT_RANK(player_index, forward_delta) KING_RANK(player_index) + ((forward_delta) << 2)
+#define PLAYER_WIN(player_index) (((int16_t[]){INT16_MAX, -INT16_MAX})[player_index])
+#define MOVE(origin_square_index, destination_square_index, flag) ((origin_square_index) | ((destination_square_index) << 6) | ((flag) << 12))
+#define MOVE_ORIGIN(move) ((move) & 0b111111)
+#define MOVE_DESTINATION(move) (((move) >> 6) & 0b111111)
+#define MOVE_FLAG(move) ((move) >> 12)
+
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+#define NODE_ACTIVE_PLAYER_INDEX(node) (node)->active_player_index
+#else
+#define NODE_ACTIVE_PLAYER_INDEX(node) (node)->position.active_player_index
+#endif
+
+uint32_t fold_hash(uint32_t hash, uint8_t bit_count)
+{
+    return ((hash >> bit_count) ^ hash) & (((uint32_t)1 << bit_count) - 1);
+}
+
+typedef enum Direction
+{
+    DIRECTION_N,
+    DIRECTION_E,
+    DIRECTION_S,
+    DIRECTION_W,
+    DIRECTION_NE,
+    DIRECTION_SE,
+    DIRECTION_SW,
+    DIRECTION_NW
+} Direction;
+
+int8_t g_direction_deltas[8][2] = { [DIRECTION_N] = { 1, 0 },[DIRECTION_E] = { 0, 1 },
+[DIRECTION_S] = { -1, 0 },[DIRECTION_W] = { 0, -1 },[DIRECTION_NE] = { 1, 1 },
+[DIRECTION_SE] = { -1, 1 },[DIRECTION_SW] = { -1, -1 },[DIRECTION_NW] = { 1, -1 } };
+
+typedef struct SlidingAttackTable
+{
+    uint64_t*attack_masks;
+    uint64_t occupancy_mask;
+    uint64_t magic;
+    uint8_t shift;
+} SlidingAttackTable;
+
+uint64_t g_sliding_attack_masks[107648];
+SlidingAttackTable g_bishop_attack_tables[64];
+SlidingAttackTable g_rook_attack_tables[64];
+
+#include "geometry_tables.c"
+
+#define SQUARE_MASK(square_index) ((uint64_t)1 << (square_index))
+#define RANK_MASK(rank) ((uint64_t)0xff << (FILE_COUNT * (rank)))
+#define FILE_MASK(file) ((uint64_t)0x0101010101010101 << (file))
+#define OCCUPANCY(position) ((position)->player_masks[0] | (position)->player_masks[1])
+
+#ifdef __BMI2__
+#define SLIDING_ATTACK_INDEX(table, occupancy) _pext_u64(occupancy, (table)->occupancy_mask)
+#else
+#define SLIDING_ATTACK_INDEX(table, occupancy) ((((occupancy) & (table)->occupancy_mask) * (table)->magic) >> (table)->shift)
+#endif
+
+uint64_t get_bishop_attack_mask(uint8_t square_index, uint64_t occupancy)
+{
+    SlidingAttackTable*table = g_bishop_attack_tables + square_index;
+    return table->attack_masks[SLIDING_ATTACK_INDEX(table, occupancy)];
+}
+
+uint64_t get_rook_attack_mask(uint8_t square_index, uint64_t occupancy)
+{
+    SlidingAttackTable*table = g_rook_attack_tables + square_index;
+    return table->attack_masks[SLIDING_ATTACK_INDEX(table, occupancy)];
+}
+
+uint64_t get_ray_attack_mask(uint8_t square_index, Direction direction, uint64_t occupancy)
+{
+    uint64_t out = g_ray_masks[direction][square_index];
+    uint64_t blocker_mask = out & occupancy;
+    if (blocker_mask)
+    {
+        uint32_t blocker_square_index;
+        if (g_direction_deltas[direction][0] > 0 ||
+            (!g_direction_deltas[direction][0] && g_direction_deltas[direction][1] > 0))
+        {
+            BIT_SCAN_FORWARD_64(&blocker_square_index, blocker_mask);
+        }
+        else
+        {
+            BIT_SCAN_REVERSE_64(&blocker_square_index, blocker_mask);
+        }
+        out ^= g_ray_masks[direction][blocker_square_index];
+    }
+    return out;
+}
+
+uint64_t g_random_state = 0x9e3779b97f4a7c15;
+
+uint64_t get_random_uint64(void)
+{
+    g_random_state ^= g_random_state << 13;
+    g_random_state ^= g_random_state >> 7;
+    g_random_state ^= g_random_state << 17;
+    return g_random_state;
+}
+
+uint8_t get_set_bit_count(uint64_t mask)
+{
+    uint8_t out = 0;
+    while (mask)
+    {
+        mask &= mask - 1;
+        ++out;
+    }
+    return out;
+}
+
+void init_sliding_attack_tables(SlidingAttackTable tables[64], Direction first_direction,
+    uint64_t**next_attack_mask)
+{
+    uint64_t occupancies[4096];
+    uint64_t attack_masks[4096];
+#ifndef __BMI2__
+    uint32_t attempts[4096] = { 0 };
+    uint32_t attempt = 0;
+#endif
+    for (uint8_t square_index = 0; square_index < 64; ++square_index)
+    {
+        SlidingAttackTable*table = tables + square_index;
+        table->occupancy_mask = 0;
+        for (Direction direction = first_direction; direction < first_direction + 4; ++direction)
+        {
+            uint64_t edge_square_mask = 0;
+            switch (g_direction_deltas[direction][0])
+            {
+            case 1:
+            {
+                edge_square_mask |= RANK_MASK(7);
+                break;
+            }
+            case -1:
+            {
+                edge_square_mask |= RANK_MASK(0);
+            }
+            }
+            switch (g_direction_deltas[direction][1])
+            {
+            case 1:
+            {
+                edge_square_mask |= FILE_MASK(7);
+                break;
+            }
+            case -1:
+            {
+                edge_square_mask |= FILE_MASK(0);
+            }
+            }
+            uint64_t ray = get_ray_attack_mask(square_index, direction, 0);
+            table->occupancy_mask |= ray & ~edge_square_mask;
+        }
+        uint8_t occupancy_bit_count = get_set_bit_count(table->occupancy_mask);
+        table->shift = 64 - occupancy_bit_count;
+        table->attack_masks = *next_attack_mask;
+        *next_attack_mask += (size_t)1 << occupancy_bit_count;
+        size_t occupancy_count = 0;
+        uint64_t occupancy = 0;
+        do
+        {
+            occupancies[occupancy_count] = occupancy;
+            attack_masks[occupancy_count] = 0;
+            for (Direction direction = first_direction; direction < first_direction + 4;
+                ++direction)
+            {
+                attack_masks[occupancy_count] |=
+                    get_ray_attack_mask(square_index, direction, occupancy);
+            }
+            ++occupancy_count;
+            occupancy = (occupancy - table->occupancy_mask) & table->occupancy_mask;
+        } while (occupancy);
+#ifdef __BMI2__
+        for (size_t i = 0; i < occupancy_count; ++i)
+        {
+            table->attack_masks[SLIDING_ATTACK_INDEX(table, occupancies[i])] = attack_masks[i];
+        }
+#else
+        while (true)
+        {
+            table->magic = get_random_uint64() & get_random_uint64() & get_random_uint64();
+            if (get_set_bit_count((table->occupancy_mask * table->magic) >> 56) < 6)
+            {
+                continue;
+            }
+            ++attempt;
+            size_t i = 0;
+            for (; i < occupancy_count; ++i)
+            {
+                uint64_t index = SLIDING_ATTACK_INDEX(table, occupancies[i]);
+                if (attempts[index] < attempt)
+                {
+                    attempts[index] = attempt;
+                    table->attack_masks[index] = attack_masks[i];
+                }
+                else if (table->attack_masks[index] != attack_masks[i])
+                {
+                    break;
+                }
+            }
+            if (i == occupancy_count)
+            {
+                break;
+            }
+        }
+#endif
+    }
+}
+
+void init_attack_tables(void)
+{
+    uint64_t*next_attack_mask = g_sliding_attack_masks;
+    init_sliding_attack_tables(g_bishop_attack_tables, DIRECTION_NE, &next_attack_mask);
+    init_sliding_attack_tables(g_rook_attack_tables, DIRECTION_N, &next_attack_mask);
+    ASSERT(next_attack_mask == g_sliding_attack_masks + ARRAY_COUNT(g_sliding_attack_masks));
+}
+
+uint64_t g_zobrist_piece_keys[2][PIECE_TYPE_COUNT][64];
+uint64_t g_zobrist_castling_keys[16];
+uint64_t g_zobrist_en_passant_keys[FILE_COUNT + 1];
+uint64_t g_zobrist_active_player_key;
+
+#define ZOBRIST_PIECE_KEY(piece_index, piece_type, square_index)\
+    g_zobrist_piece_keys[PLAYER_INDEX(piece_index)][piece_type][square_index]
+
+void init_zobrist_keys(void)
+{
+    for (uint8_t player_index = 0; player_index < 2; ++player_index)
+    {
+        for (PieceType piece_type = 0; piece_type < PIECE_TYPE_COUNT; ++piece_type)
+        {
+            for (uint8_t square_index = 0; square_index < 64; ++square_index)
+            {
+                g_zobrist_piece_keys[player_index][piece_type][square_index] =
+                    get_random_uint64();
+            }
+        }
+    }
+    for (uint8_t i = 0; i < ARRAY_COUNT(g_zobrist_castling_keys); ++i)
+    {
+        g_zobrist_castling_keys[i] = get_random_uint64();
+    }
+    for (uint8_t file = 0; file < FILE_COUNT; ++file)
+    {
+        g_zobrist_en_passant_keys[file] = get_random_uint64();
+    }
+    g_zobrist_en_passant_keys[FILE_COUNT] = 0;
+    g_zobrist_active_player_key = get_random_uint64();
+}
+
+void init_zobrist_key(Position*position)
+{
+    position->zobrist_key = g_zobrist_castling_keys[position->castling_rights_lost] ^
+        g_zobrist_en_passant_keys[position->en_passant_file];
+    if (position->active_player_index)
+    {
+        position->zobrist_key ^= g_zobrist_active_player_key;
+    }
+    for (uint8_t piece_index = 0; piece_index < 32; ++piece_index)
+    {
+        Piece piece = position->pieces[piece_index];
+        if (piece.square_index != NULL_SQUARE)
+        {
+            position->zobrist_key ^=
+                ZOBRIST_PIECE_KEY(piece_index, piece.piece_type, piece.square_index);
+        }
+    }
+}
+
+uint64_t get_piece_attack_mask(Position*position, uint8_t piece_index)
+{
+    Piece piece = position->pieces[piece_index];
+    switch (piece.piece_type)
+    {
+    case PIECE_BISHOP:
+    {
+        return get_bishop_attack_mask(piece.square_index, OCCUPANCY(position));
+    }
+    case PIECE_KING:
+    {
+        return g_king_attack_masks[piece.square_index];
+    }
+    case PIECE_KNIGHT:
+    {
+        return g_knight_attack_masks[piece.square_index];
+    }
+    case PIECE_QUEEN:
+    {
+        uint64_t occupancy = OCCUPANCY(position);
+        return get_bishop_attack_mask(piece.square_index, occupancy) |
+            get_rook_attack_mask(piece.square_index, occupancy);
+    }
+    case PIECE_ROOK:
+    {
+        return get_rook_attack_mask(piece.square_index, OCCUPANCY(position));
+    }
+    default:
+    {
+        return g_pawn_attack_masks[PLAYER_INDEX(piece_index)][piece.square_index];
+    }
+    }
+}
+
+void increment_square_control_counts(Position*position, int8_t control_counts[64],
+    uint8_t player_index)
+{
+    int8_t point = FORWARD_DELTA(!player_index);
+    uint8_t player_pieces_index = PLAYER_PIECES_INDEX(player_index);
+    uint8_t max_piece_index = player_pieces_index + 16;
+    for (uint8_t piece_index = player_pieces_index; piece_index < max_piece_index; ++piece_index)
+    {
+        if (position->pieces[piece_index].square_index == NULL_SQUARE)
+        {
+            continue;
+        }
+        uint64_t attack_mask = get_piece_attack_mask(position, piece_index);
+        while (attack_mask)
+        {
+            uint32_t square_index;
+            BIT_SCAN_FORWARD_64(&square_index, attack_mask);
+            attack_mask &= attack_mask - 1;
+            control_counts[square_index] += point;
+        }
+    }
+}
+
+void capture_piece(Position*position, uint8_t piece_index)
+{
+    Piece*piece = position->pieces + piece_index;
+    uint64_t square_mask = SQUARE_MASK(piece->square_index);
+    position->piece_type_masks[piece->piece_type] &= ~square_mask;
+    position->player_masks[PLAYER_INDEX(piece_index)] &= ~square_mask;
+    position->zobrist_key ^= ZOBRIST_PIECE_KEY(piece_index, piece->piece_type, piece->square_index);
+    piece->square_index = NULL_SQUARE;
+    position->reset_draw_by_50_count = true;
+}
+
+void place_piece(Position*position, uint8_t piece_index, uint8_t square_index)
+{
+    Piece*piece = position->pieces + piece_index;
+    uint64_t square_mask = SQUARE_MASK(square_index);
+    position->piece_type_masks[piece->piece_type] |= square_mask;
+    position->player_masks[PLAYER_INDEX(piece_index)] |= square_mask;
+    position->zobrist_key ^= ZOBRIST_PIECE_KEY(piece_index, piece->piece_type, square_index);
+    position->squares[square_index] = piece_index;
+    piece->square_index = square_index;
+}
+
+void move_piece(Position*position, uint8_t piece_index, uint8_t destination_square_index)
+{
+    position->squares[destination_square_index] = piece_index;
+    Piece*piece = position->pieces + piece_index;
+    position->squares[piece->square_index] = NULL_PIECE;
+    uint64_t move_mask = SQUARE_MASK(piece->square_index) | SQUARE_MASK(destination_square_index);
+    position->piece_type_masks[piece->piece_type] ^= move_mask;
+    position->player_masks[PLAYER_INDEX(piece_index)] ^= move_mask;
+    position->zobrist_key ^=
+        ZOBRIST_PIECE_KEY(piece_index, piece->piece_type, piece->square_index) ^
+        ZOBRIST_PIECE_KEY(piece_index, piece->piece_type, destination_square_index);
+    piece->square_index = destination_square_index;
+}
+
+void set_piece_type(Position*position, uint8_t piece_index, PieceType piece_type)
+{
+    Piece*piece = position->pieces + piece_index;
+    uint64_t square_mask = SQUARE_MASK(piece->square_index);
+    position->piece_type_masks[piece->piece_type] &= ~square_mask;
+    position->piece_type_masks[piece_type] |= square_mask;
+    position->zobrist_key ^=
+        ZOBRIST_PIECE_KEY(piece_index, piece->piece_type, piece->square_index) ^
+        ZOBRIST_PIECE_KEY(piece_index, piece_type, piece->square_index);
+    piece->piece_type = piece_type;
+}
+
+void init_square_control_counts(Position*position)
+{
+    memset(position->square_control_counts, 0, sizeof(position->square_control_counts));
+    increment_square_control_counts(position, position->square_control_counts[PLAYER_INDEX_WHITE],
+        PLAYER_INDEX_WHITE);
+    increment_square_control_counts(position, position->square_control_counts[PLAYER_INDEX_BLACK],
+        PLAYER_INDEX_BLACK);
+}
+
+uint32_t get_slider_piece_indices_attacking(Position*position, uint64_t square_mask)
+{
+    uint64_t occupancy = OCCUPANCY(position);
+    uint64_t diagonal_slider_mask =
+        position->piece_type_masks[PIECE_BISHOP] | position->piece_type_masks[PIECE_QUEEN];
+    uint64_t axial_slider_mask =
+        position->piece_type_masks[PIECE_ROOK] | position->piece_type_masks[PIECE_QUEEN];
+    uint64_t slider_mask = 0;
+    while (square_mask)
+    {
+        uint32_t square_index;
+        BIT_SCAN_FORWARD_64(&square_index, square_mask);
+        square_mask &= square_mask - 1;
+        slider_mask |= (get_bishop_attack_mask(square_index, occupancy) & diagonal_slider_mask) |
+            (get_rook_attack_mask(square_index, occupancy) & axial_slider_mask);
+    }
+    uint32_t out = 0;
+    while (slider_mask)
+    {
+        uint32_t square_index;
+        BIT_SCAN_FORWARD_64(&square_index, slider_mask);
+        slider_mask &= slider_mask - 1;
+        out |= (uint32_t)1 << position->squares[square_index];
+    }
+    return out;
+}
+
+void update_piece_control_counts(Position*position, uint32_t piece_indices, int8_t sign)
+{
+    while (piece_indices)
+    {
+        uint32_t piece_index;
+        BIT_SCAN_FORWARD(&piece_index, piece_indices);
+        piece_indices &= piece_indices - 1;
+        if (position->pieces[piece_index].square_index == NULL_SQUARE)
+        {
+            continue;
+        }
+        uint8_t player_index = PLAYER_INDEX(piece_index);
+        int8_t point = sign * FORWARD_DELTA(!player_index);
+        int8_t*control_counts = position->square_control_counts[player_index];
+        uint64_t attack_mask = get_piece_attack_mask(position, piece_index);
+        while (attack_mask)
+        {
+            uint32_t square_index;
+            BIT_SCAN_FORWARD_64(&square_index, attack_mask);
+            attack_mask &= attack_mask - 1;
+            control_counts[square_index] += point;
+        }
+    }
+}
+
+void move_piece_and_update_control_counts(Position*position, uint8_t piece_index,
+    uint8_t destination_square_index, uint8_t captured_piece_index)
+{
+    uint64_t changed_square_mask = SQUARE_MASK(position->pieces[piece_index].square_index) |
+        SQUARE_MASK(destination_square_index);
+    uint32_t affected_piece_indices = (uint32_t)1 << piece_index;
+    if (captured_piece_index != NULL_PIECE)
+    {
+        changed_square_mask |= SQUARE_MASK(position->pieces[captured_piece_index].square_index);
+        affected_piece_indices |= (uint32_t)1 << captured_piece_index;
+    }
+    affected_piece_indices |= get_slider_piece_indices_attacking(position, changed_square_mask);
+    update_piece_control_counts(position, affected_piece_indices, -1);
+    if (captured_piece_index != NULL_PIECE)
+    {
+        position->squares[position->pieces[captured_piece_index].square_index] = NULL_PIECE;
+        capture_piece(position, captured_piece_index);
+    }
+    move_piece(position, piece_index, destination_square_index);
+    update_piece_control_counts(position, affected_piece_indices, 1);
+}
+
+void place_piece_and_update_control_counts(Position*position, uint8_t piece_index,
+    uint8_t square_index)
+{
+    uint32_t affected_piece_indices =
+        get_slider_piece_indices_attacking(position, SQUARE_MASK(square_index));
+    update_piece_control_counts(position, affected_piece_indices, -1);
+    place_piece(position, piece_index, square_index);
+    update_piece_control_counts(position, affected_piece_indices | (uint32_t)1 << piece_index, 1);
+}
+
+void set_piece_type_and_update_control_counts(Position*position, uint8_t piece_index,
+    PieceType piece_type)
+{
+    update_piece_control_counts(position, (uint32_t)1 << piece_index, -1);
+    set_piece_type(position, piece_index, piece_type);
+    update_piece_control_counts(position, (uint32_t)1 << piece_index, 1);
+}
+
+bool king_is_attacked(Position*position, uint8_t player_index)
+{
+    return position->square_control_counts[!player_index]
+        [position->pieces[PLAYER_PIECES_INDEX(player_index)].square_index];
+}
+
+uint64_t get_attacker_mask(Position*position, uint8_t square_index,
+    uint8_t attacking_player_index, uint64_t occupancy)
+{
+    return ((g_pawn_attack_masks[!attacking_player_index][square_index] &
+        position->piece_type_masks[PIECE_PAWN]) |
+        (g_knight_attack_masks[square_index] & position->piece_type_masks[PIECE_KNIGHT]) |
+        (g_king_attack_masks[square_index] & position->piece_type_masks[PIECE_KING]) |
+        (get_bishop_attack_mask(square_index, occupancy) &
+            (position->piece_type_masks[PIECE_BISHOP] | position->piece_type_masks[PIECE_QUEEN])) |
+        (get_rook_attack_mask(square_index, occupancy) &
+            (position->piece_type_masks[PIECE_ROOK] | position->piece_type_masks[PIECE_QUEEN]))) &
+        position->player_masks[attacking_player_index];
+}
+
+bool square_is_attacked(Position*position, uint8_t square_index, uint8_t attacking_player_index,
+    uint64_t occupancy)
+{
+    uint64_t attacking_piece_mask = position->player_masks[attacking_player_index];
+    if ((g_pawn_attack_masks[!attacking_player_index][square_index] &
+        position->piece_type_masks[PIECE_PAWN] & attacking_piece_mask) ||
+        (g_knight_attack_masks[square_index] & position->piece_type_masks[PIECE_KNIGHT] &
+            attacking_piece_mask) ||
+        (g_king_attack_masks[square_index] & position->piece_type_masks[PIECE_KING] &
+            attacking_piece_mask))
+    {
+        return true;
+    }
+    uint64_t queen_mask = position->piece_type_masks[PIECE_QUEEN] & attacking_piece_mask;
+    uint64_t diagonal_slider_mask =
+        (position->piece_type_masks[PIECE_BISHOP] & attacking_piece_mask) | queen_mask;
+    if (diagonal_slider_mask && (get_bishop_attack_mask(square_index, occupancy) &
+        diagonal_slider_mask))
+    {
+        return true;
+    }
+    uint64_t axial_slider_mask =
+        (position->piece_type_masks[PIECE_ROOK] & attacking_piece_mask) | queen_mask;
+    return axial_slider_mask && (get_rook_attack_mask(square_index, occupancy) & axial_slider_mask);
+}
+
+void get_blocker_masks(Position*position, uint8_t king_player_index, uint64_t blocker_masks[16])
+{
+    uint8_t player_index = position->active_player_index;
+    uint8_t player_pieces_index = PLAYER_PIECES_INDEX(player_index);
+    for (uint8_t i = 0; i < 16; ++i)
+    {
+        blocker_masks[i] = UINT64_MAX;
+    }
+    uint8_t king_square_index =
+        position->pieces[PLAYER_PIECES_INDEX(king_player_index)].square_index;
+    uint64_t queen_mask = position->piece_type_masks[PIECE_QUEEN];
+    uint64_t slider_mask = ((get_bishop_attack_mask(king_square_index, 0) &
+        (position->piece_type_masks[PIECE_BISHOP] | queen_mask)) |
+        (get_rook_attack_mask(king_square_index, 0) &
+            (position->piece_type_masks[PIECE_ROOK] | queen_mask))) &
+        position->player_masks[!king_player_index];
+    uint64_t occupancy = OCCUPANCY(position);
+    while (slider_mask)
+    {
+        uint32_t slider_square_index;
+        BIT_SCAN_FORWARD_64(&slider_square_index, slider_mask);
+        slider_mask &= slider_mask - 1;
+        uint64_t between_mask = g_squares_between_masks[king_square_index][slider_square_index];
+        uint64_t blocker_mask = between_mask & occupancy;
+        if (blocker_mask && !(blocker_mask & (blocker_mask - 1)) &&
+            (blocker_mask & position->player_masks[player_index]))
+        {
+            uint32_t blocker_square_index;
+            BIT_SCAN_FORWARD_64(&blocker_square_index, blocker_mask);
+            blocker_masks[position->squares[blocker_square_index] - player_pieces_index] =
+                between_mask | SQUARE_MASK(slider_square_index);
+        }
+    }
+}
+
+void get_check_masks(Position*position, uint64_t check_masks[PIECE_TYPE_COUNT])
+{
+    uint8_t king_square_index =
+        position->pieces[PLAYER_PIECES_INDEX(!position->active_player_index)].square_index;
+    uint64_t occupancy = OCCUPANCY(position);
+    check_masks[PIECE_BISHOP] = get_bishop_attack_mask(king_square_index, occupancy);
+    check_masks[PIECE_KING] = 0;
+    check_masks[PIECE_KNIGHT] = g_knight_attack_masks[king_square_index];
+    check_masks[PIECE_ROOK] = get_rook_attack_mask(king_square_index, occupancy);
+    check_masks[PIECE_QUEEN] = check_masks[PIECE_BISHOP] | check_masks[PIECE_ROOK];
+    check_masks[PIECE_PAWN] =
+        g_pawn_attack_masks[!position->active_player_index][king_square_index];
+}
+
+uint8_t get_castling_right_of_rook_square(uint8_t square_index)
+{
+    switch (square_index)
+    {
+    case SQUARE_INDEX(KING_RANK(PLAYER_INDEX_WHITE), 0):
+    {
+        return 1 << (PLAYER_INDEX_WHITE << 1);
+    }
+    case SQUARE_INDEX(KING_RANK(PLAYER_INDEX_WHITE), 7):
+    {
+        return 0b10 << (PLAYER_INDEX_WHITE << 1);
+    }
+    case SQUARE_INDEX(KING_RANK(PLAYER_INDEX_BLACK), 0):
+    {
+        return 1 << (PLAYER_INDEX_BLACK << 1);
+    }
+    case SQUARE_INDEX(KING_RANK(PLAYER_INDEX_BLACK), 7):
+    {
+        return 0b10 << (PLAYER_INDEX_BLACK << 1);
+    }
+    default:
+    {
+        return 0;
+    }
+    }
+}
+
+uint8_t get_castling_rook_origin_square_index(uint8_t king_origin_square_index,
+    uint8_t king_destination_square_index)
+{
+    if (king_destination_square_index > king_origin_square_index)
+    {
+        return king_origin_square_index + 3;
+    }
+    return king_origin_square_index - 4;
+}
+
+void make_move(Position*position, Move move, MoveUndo*undo)
+{
+    undo->en_passant_file = position->en_passant_file;
+    undo->castling_rights_lost = position->castling_rights_lost;
+    undo->reset_draw_by_50_count = position->reset_draw_by_50_count;
+    uint8_t origin_square_index = MOVE_ORIGIN(move);
+    uint8_t destination_square_index = MOVE_DESTINATION(move);
+    uint8_t flag = MOVE_FLAG(move);
+    uint8_t piece_index = position->squares[origin_square_index];
+    position->reset_draw_by_50_count =
+        position->pieces[piece_index].piece_type == PIECE_PAWN;
+    position->en_passant_file = FILE_COUNT;
+    switch (flag)
+    {
+    case MOVE_FLAG_DOUBLE_PUSH:
+    {
+        position->en_passant_file = FILE(origin_square_index);
+        undo->captured_piece_index = NULL_PIECE;
+        break;
+    }
+    case MOVE_FLAG_CASTLE:
+    {
+        move_piece_and_update_control_counts(position, position->squares
+            [get_castling_rook_origin_square_index(origin_square_index,
+                destination_square_index)],
+            (origin_square_index + destination_square_index) >> 1, NULL_PIECE);
+        undo->captured_piece_index = NULL_PIECE;
+        break;
+    }
+    case MOVE_FLAG_EN_PASSANT:
+    {
+        undo->captured_piece_index = position->squares
+            [SQUARE_INDEX(RANK(origin_square_index), FILE(destination_square_index))];
+        break;
+    }
+    default:
+    {
+        undo->captured_piece_index = position->squares[destination_square_index];
+    }
+    }
+    move_piece_and_update_control_counts(position, piece_index, destination_square_index,
+        undo->captured_piece_index);
+    if (flag >= MOVE_FLAG_PROMOTION)
+    {
+        set_piece_type_and_update_control_counts(position, piece_index,
+            g_promotion_options[flag - MOVE_FLAG_PROMOTION]);
+    }
+    uint8_t castling_rights_lost = get_castling_right_of_rook_square(origin_square_index) |
+        get_castling_right_of_rook_square(destination_square_index);
+    if (piece_index == PLAYER_PIECES_INDEX(position->active_player_index))
+    {
+        castling_rights_lost |= 0b11 << (position->active_player_index << 1);
+    }
+    if ((position->castling_rights_lost & castling_rights_lost) != castling_rights_lost)
+    {
+        position->castling_rights_lost |= castling_rights_lost;
+        position->reset_draw_by_50_count = true;
+    }
+    position->active_player_index = !position->active_player_index;
+    position->zobrist_key ^= g_zobrist_active_player_key ^
+        g_zobrist_castling_keys[undo->castling_rights_lost] ^
+        g_zobrist_castling_keys[position->castling_rights_lost] ^
+        g_zobrist_en_passant_keys[undo->en_passant_file] ^
+        g_zobrist_en_passant_keys[position->en_passant_file];
+}
+
+void unmake_move(Position*position, Move move, MoveUndo*undo)
+{
+    uint8_t origin_square_index = MOVE_ORIGIN(move);
+    uint8_t destination_square_index = MOVE_DESTINATION(move);
+    uint8_t flag = MOVE_FLAG(move);
+    uint8_t piece_index = position->squares[destination_square_index];
+    position->active_player_index = !position->active_player_index;
+    if (flag >= MOVE_FLAG_PROMOTION)
+    {
+        set_piece_type_and_update_control_counts(position, piece_index, PIECE_PAWN);
+    }
+    move_piece_and_update_control_counts(position, piece_index, origin_square_index, NULL_PIECE);
+    switch (flag)
+    {
+    case MOVE_FLAG_CASTLE:
+    {
+        move_piece_and_update_control_counts(position,
+            position->squares[(origin_square_index + destination_square_index) >> 1],
+            get_castling_rook_origin_square_index(origin_square_index,
+                destination_square_index), NULL_PIECE);
+        break;
+    }
+    case MOVE_FLAG_EN_PASSANT:
+    {
+        place_piece_and_update_control_counts(position, undo->captured_piece_index,
+            SQUARE_INDEX(RANK(origin_square_index), FILE(destination_square_index)));
+        break;
+    }
+    default:
+    {
+        if (undo->captured_piece_index != NULL_PIECE)
+        {
+            place_piece_and_update_control_counts(position, undo->captured_piece_index,
+                destination_square_index);
+        }
+    }
+    }
+    position->zobrist_key ^= g_zobrist_active_player_key ^
+        g_zobrist_castling_keys[undo->castling_rights_lost] ^
+        g_zobrist_castling_keys[position->castling_rights_lost] ^
+        g_zobrist_en_passant_keys[undo->en_passant_file] ^
+        g_zobrist_en_passant_keys[position->en_passant_file];
+    position->en_passant_file = undo->en_passant_file;
+    position->castling_rights_lost = undo->castling_rights_lost;
+    position->reset_draw_by_50_count = undo->reset_draw_by_50_count;
+}
+
+NodeIndex get_tree_position_bucket_index(uint32_t hash)
+{
+    return fold_hash(hash, g_tree_position_bucket_index_bit_count);
+}
+
+NodeIndex get_position_tree_node_capacity(uint64_t byte_count)
+{
+    size_t node_byte_count =
+        sizeof(PositionTreeNode) + 2 * sizeof(NodeIndex) + sizeof(FrontierEntry);
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+    node_byte_count += sizeof(Move);
+#endif
+    if (g_search_mode == SEARCH_MODE_PROOF_NUMBER)
+    {
+        node_byte_count += sizeof(ProofNumbers);
+    }
+    uint64_t out = byte_count / node_byte_count;
+    if (out < 32 * MAX_MOVE_COUNT)
+    {
+        return 32 * MAX_MOVE_COUNT;
+    }
+    if (out > NULL_POSITION_TREE_NODE)
+    {
+        return NULL_POSITION_TREE_NODE;
+    }
+    return out;
+}
+
+bool commit_position_tree_array(void*array, size_t element_size, NodeIndex old_count,
+    uint64_t new_count)
+{
+    size_t first_byte_index = ((size_t)old_count * element_size) & ~(size_t)(MEMORY_PAGE_SIZE - 1);
+    return COMMIT_MEMORY((char*)array + first_byte_index,
+        (size_t)new_count * element_size - first_byte_index);
+}
+
+bool commit_position_tree_nodes(void)
+{
+    if (g_committed_position_tree_node_count == g_position_tree_node_capacity)
+    {
+        return false;
+    }
+    uint64_t new_count =
+        (uint64_t)g_committed_position_tree_node_count + POSITION_TREE_COMMIT_NODE_COUNT;
+    if (new_count > g_position_tree_node_capacity)
+    {
+        new_count = g_position_tree_node_capacity;
+    }
+    if (!commit_position_tree_array(g_position_tree_nodes, sizeof(PositionTreeNode),
+            g_committed_position_tree_node_count, new_count) ||
+        !commit_position_tree_array(g_new_position_tree_node_indices, sizeof(NodeIndex),
+            g_committed_position_tree_node_count, new_count) ||
+        !commit_position_tree_array(g_frontier, sizeof(FrontierEntry),
+            g_committed_position_tree_node_count, new_count))
+    {
+        return false;
+    }
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+    if (!commit_position_tree_array(g_replayed_moves, sizeof(Move),
+        g_committed_position_tree_node_count, new_count))
+    {
+        return false;
+    }
+#endif
+    if (g_proof_numbers && !commit_position_tree_array(g_proof_numbers, sizeof(ProofNumbers),
+        g_committed_position_tree_node_count, new_count))
+    {
+        return false;
+    }
+    g_committed_position_tree_node_count = new_count;
+    return true;
+}
+
+void release_position_tree(void)
+{
+    RELEASE_MEMORY(g_position_tree_nodes,
+        (size_t)g_position_tree_node_capacity * sizeof(PositionTreeNode));
+    RELEASE_MEMORY(g_new_position_tree_node_indices,
+        (size_t)g_position_tree_node_capacity * sizeof(NodeIndex));
+    RELEASE_MEMORY(g_frontier, (size_t)g_position_tree_node_capacity * sizeof(FrontierEntry));
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+    RELEASE_MEMORY(g_replayed_moves, (size_t)g_position_tree_node_capacity * sizeof(Move));
+#endif
+    RELEASE_MEMORY(g_proof_numbers, (size_t)g_position_tree_node_capacity * sizeof(ProofNumbers));
+    FREE_MEMORY(g_tree_position_buckets);
+    g_position_tree_nodes = 0;
+}
+
+bool init_position_tree(NodeIndex node_capacity)
+{
+    while (true)
+    {
+        g_position_tree_node_capacity = node_capacity;
+        g_position_tree_nodes = RESERVE_MEMORY((size_t)node_capacity * sizeof(PositionTreeNode));
+        g_new_position_tree_node_indices =
+            RESERVE_MEMORY((size_t)node_capacity * sizeof(NodeIndex));
+        g_frontier = RESERVE_MEMORY((size_t)node_capacity * sizeof(FrontierEntry));
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+        g_replayed_moves = RESERVE_MEMORY((size_t)node_capacity * sizeof(Move));
+#endif
+        g_proof_numbers = 0;
+        if (g_search_mode == SEARCH_MODE_PROOF_NUMBER)
+        {
+            g_proof_numbers = RESERVE_MEMORY((size_t)node_capacity * sizeof(ProofNumbers));
+        }
+        g_tree_position_bucket_index_bit_count = 0;
+        while (((NodeIndex)2 << g_tree_position_bucket_index_bit_count) <= node_capacity &&
+            g_tree_position_bucket_index_bit_count < 31)
+        {
+            ++g_tree_position_bucket_index_bit_count;
+        }
+        size_t bucket_count = (size_t)1 << g_tree_position_bucket_index_bit_count;
+        g_tree_position_buckets = ALLOCATE(bucket_count * sizeof(NodeIndex));
+        g_committed_position_tree_node_count = 0;
+        if (g_position_tree_nodes && g_new_position_tree_node_indices && g_frontier &&
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+            g_replayed_moves &&
+#endif
+            (g_proof_numbers || g_search_mode != SEARCH_MODE_PROOF_NUMBER) &&
+            g_tree_position_buckets && commit_position_tree_nodes())
+        {
+            memset(g_tree_position_buckets, 0xff, bucket_count * sizeof(NodeIndex));
+            g_index_of_first_free_position_tree_node = 0;
+            g_frontier_size = 0;
+            return true;
+        }
+        release_position_tree();
+        if (node_capacity / 2 < MIN_POSITION_TREE_NODE_CAPACITY)
+        {
+            return false;
+        }
+        node_capacity /= 2;
+    }
+}
+
+void clear_position_tree(void)
+{
+    for (NodeIndex node_index = 0; node_index < g_index_of_first_free_position_tree_node;
+        ++node_index)
+    {
+        g_tree_position_buckets[get_tree_position_bucket_index(
+            GET_POSITION_TREE_NODE(node_index)->position_hash)] = NULL_POSITION_TREE_NODE;
+    }
+    g_frontier_size = 0;
+}
+
+void push_frontier_node(NodeIndex node_index, uint32_t priority)
+{
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+    if (node->is_queued)
+    {
+        return;
+    }
+    node->is_queued = true;
+    NodeIndex entry_index = g_frontier_size;
+    ++g_frontier_size;
+    while (entry_index)
+    {
+        NodeIndex parent_entry_index = (entry_index - 1) / 2;
+        if (g_frontier[parent_entry_index].priority <= priority)
+        {
+            break;
+        }
+        g_frontier[entry_index] = g_frontier[parent_entry_index];
+        entry_index = parent_entry_index;
+    }
+    g_frontier[entry_index] = (FrontierEntry) { priority, node_index };
+}
+
+uint32_t get_frontier_priority(NodeIndex node_index)
+{
+    uint32_t out = 0;
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+    while (node->parent_index != NULL_POSITION_TREE_NODE)
+    {
+        PositionTreeNode*parent = GET_POSITION_TREE_NODE(node->parent_index);
+        int32_t evaluation_loss = node->evaluation - parent->evaluation;
+        if (NODE_ACTIVE_PLAYER_INDEX(parent) == PLAYER_INDEX_WHITE)
+        {
+            evaluation_loss = -evaluation_loss;
+        }
+        out += FRONTIER_PLY_PRIORITY;
+        if (evaluation_loss > 0)
+        {
+            out += evaluation_loss;
+        }
+        node = parent;
+    }
+    return out;
+}
+
+FrontierEntry remove_first_frontier_entry(void)
+{
+    FrontierEntry out = *g_frontier;
+    --g_frontier_size;
+    FrontierEntry last_entry = g_frontier[g_frontier_size];
+    NodeIndex entry_index = 0;
+    while (true)
+    {
+        NodeIndex child_entry_index = 2 * entry_index + 1;
+        if (child_entry_index >= g_frontier_size)
+        {
+            break;
+        }
+        if (child_entry_index + 1 < g_frontier_size &&
+            g_frontier[child_entry_index + 1].priority < g_frontier[child_entry_index].priority)
+        {
+            ++child_entry_index;
+        }
+        if (last_entry.priority <= g_frontier[child_entry_index].priority)
+        {
+            break;
+        }
+        g_frontier[entry_index] = g_frontier[child_entry_index];
+        entry_index = child_entry_index;
+    }
+    g_frontier[entry_index] = last_entry;
+    return out;
+}
+
+NodeIndex pop_frontier_node(void)
+{
+    while (true)
+    {
+        FrontierEntry entry = remove_first_frontier_entry();
+        GET_POSITION_TREE_NODE(entry.node_index)->is_queued = false;
+        uint32_t priority = get_frontier_priority(entry.node_index);
+        if (priority <= entry.priority || !g_frontier_size || priority <= g_frontier->priority)
+        {
+            return entry.node_index;
+        }
+        push_frontier_node(entry.node_index, priority);
+    }
+}
+
+POSITION_TREE_STORAGE jmp_buf out_of_memory_jump_buffer;
+
+void init_position_tree_node(PositionTreeNode*node)
+{
+    node->is_leaf = true;
+    node->next_move_stage = MOVE_STAGE_CAPTURES;
+    node->has_skipped_moves = false;
+    node->is_claimed = false;
+    node->is_queued = false;
+}
+
+NodeIndex allocate_position_tree_node(void)
+{
+    if (g_index_of_first_free_position_tree_node == g_committed_position_tree_node_count &&
+        !commit_position_tree_nodes())
+    {
+        longjmp(out_of_memory_jump_buffer, 1);
+    }
+    else
+    {
+        NodeIndex new_node_index = g_index_of_first_free_position_tree_node;
+        ++g_index_of_first_free_position_tree_node;
+        init_position_tree_node(GET_POSITION_TREE_NODE(new_node_index));
+        return new_node_index;
+    }
+}
+
+void compress_position(CompressedPosition*out, Position*position)
+{
+    memset(out, 0, sizeof(*out));
+    size_t piece_hash_index = 0;
+    uint8_t shift = 0;
+    for (size_t square_index = 0; square_index < 64; ++square_index)
+    {
+        uint8_t square = position->squares[square_index];
+        if (square != NULL_PIECE)
+        {
+            out->piece_hashes[piece_hash_index] |= (position->pieces[square].piece_type |
+                (PLAYER_INDEX(square) << 3)) << shift;
+            piece_hash_index += shift >> 2;
+            shift ^= 4;
+            out->square_mask[square_index >> 3] |= 1 << (square_index & 0b111);
+        }
+    }
+    out->en_passant_file = position->en_passant_file;
+    out->castling_rights_lost = position->castling_rights_lost;
+    out->active_player_index = position->active_player_index;
+}
+
+void unpack_position(Position*out, CompressedPosition*position)
+{
+    memset(out->piece_type_masks, 0, sizeof(out->piece_type_masks));
+    memset(out->player_masks, 0, sizeof(out->player_masks));
+    uint8_t player_next_piece_index[] = { 1, 17 };
+    size_t piece_hash_index = 0;
+    uint8_t shift = 0;
+    for (size_t square_index = 0; square_index < 64; ++square_index)
+    {
+        if (position->square_mask[square_index >> 3] & (1 << (square_index & 0b111)))
+        {
+            uint8_t piece_hash = (position->piece_hashes[piece_hash_index] >> shift) & 0b1111;
+            uint8_t player_index = piece_hash >> 3;
+            PieceType piece_type = piece_hash & 0b111;
+            uint8_t piece_index;
+            if (piece_type == PIECE_KING)
+            {
+                piece_index = PLAYER_PIECES_INDEX(player_index);
+            }
+            else
+            {
+                piece_index = player_next_piece_index[player_index];
+                ++player_next_piece_index[player_index];
+            }
+            out->squares[square_index] = piece_index;
+            Piece*piece = out->pieces + piece_index;
+            piece->square_index = square_index;
+            piece->piece_type = piece_type;
+            out->piece_type_masks[piece_type] |= SQUARE_MASK(square_index);
+            out->player_masks[player_index] |= SQUARE_MASK(square_index);
+            piece_hash_index += shift >> 2;
+            shift ^= 4;
+        }
+        else
+        {
+            out->squares[square_index] = NULL_PIECE;
+        }
+    }
+    for (size_t piece_index = player_next_piece_index[0]; piece_index < 16; ++piece_index)
+    {
+        out->pieces[piece_index].square_index = NULL_SQUARE;
+    }
+    for (size_t piece_index = player_next_piece_index[1]; piece_index < 32; ++piece_index)
+    {
+        out->pieces[piece_index].square_index = NULL_SQUARE;
+    }
+    out->en_passant_file = position->en_passant_file;
+    out->castling_rights_lost = position->castling_rights_lost;
+    out->active_player_index = position->active_player_index;
+    init_square_control_counts(out);
+    init_zobrist_key(out);
+}
+
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+void decompress_position(Position*out, NodeIndex position_tree_node_index)
+{
+    NodeIndex move_count = 0;
+    NodeIndex node_index = position_tree_node_index;
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+    while (node_index != g_replayed_position_node_index &&
+        node->parent_index != NULL_POSITION_TREE_NODE)
+    {
+        g_replayed_moves[move_count] = node->move;
+        ++move_count;
+        node_index = node->parent_index;
+        node = GET_POSITION_TREE_NODE(node_index);
+    }
+    if (node_index == g_replayed_position_node_index)
+    {
+        *out = g_replayed_position;
+    }
+    else
+    {
+        *out = g_position_tree_root;
+    }
+    while (move_count)
+    {
+        --move_count;
+        MoveUndo undo;
+        make_move(out, g_replayed_moves[move_count], &undo);
+    }
+    out->node_index = position_tree_node_index;
+    g_replayed_position = *out;
+    g_replayed_position_node_index = position_tree_node_index;
+}
+
+void compress_position_to_node(Position*position, int16_t evaluation)
+{
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(position->node_index);
+    node->reset_draw_by_50_count = position->reset_draw_by_50_count;
+    node->active_player_index = position->active_player_index;
+    if (!position->node_index)
+    {
+        g_position_tree_root = *position;
+        g_replayed_position_node_index = NULL_POSITION_TREE_NODE;
+    }
+    node->position_hash = position->zobrist_key;
+    NodeIndex*index_of_position_with_same_hash =
+        g_tree_position_buckets + get_tree_position_bucket_index(node->position_hash);
+    while (true)
+    {
+        if (*index_of_position_with_same_hash == NULL_POSITION_TREE_NODE)
+        {
+            node->is_canonical = true;
+            node->index_of_next_position_with_same_hash = NULL_POSITION_TREE_NODE;
+            node->next_transposion_index = NULL_POSITION_TREE_NODE;
+            node->evaluation = evaluation;
+            *index_of_position_with_same_hash = position->node_index;
+            return;
+        }
+        PositionTreeNode*position_with_same_hash =
+            GET_POSITION_TREE_NODE(*index_of_position_with_same_hash);
+        bool positions_match = false;
+        if (position_with_same_hash->position_hash == node->position_hash)
+        {
+            Position other_position;
+            decompress_position(&other_position, *index_of_position_with_same_hash);
+            CompressedPosition compressed_position;
+            compress_position(&compressed_position, position);
+            CompressedPosition other_compressed_position;
+            compress_position(&other_compressed_position, &other_position);
+            positions_match = !memcmp(&compressed_position, &other_compressed_position,
+                sizeof(compressed_position));
+        }
+        if (!positions_match)
+        {
+            index_of_position_with_same_hash =
+                &position_with_same_hash->index_of_next_position_with_same_hash;
+        }
+        else
+        {
+            node->is_canonical = false;
+            node->next_transposion_index = position_with_same_hash->next_transposion_index;
+            position_with_same_hash->next_transposion_index = position->node_index;
+            node->evaluation = position_with_same_hash->evaluation;
+            node->evaluation_has_been_propagated_to_parents = true;
+            return;
+        }
+    }
+}
+#else
+void compress_position_to_node(Position*position, int16_t evaluation)
+{
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(position->node_index);
+    node->reset_draw_by_50_count = position->reset_draw_by_50_count;
+    compress_position(&node->position, position);
+    node->position_hash = position->zobrist_key;
+    NodeIndex*index_of_position_with_same_hash =
+        g_tree_position_buckets + get_tree_position_bucket_index(node->position_hash);
+    while (true)
+    {
+        if (*index_of_position_with_same_hash == NULL_POSITION_TREE_NODE)
+        {
+            node->is_canonical = true;
+            node->index_of_next_position_with_same_hash = NULL_POSITION_TREE_NODE;
+            node->next_transposion_index = NULL_POSITION_TREE_NODE;
+            node->evaluation = evaluation;
+            *index_of_position_with_same_hash = position->node_index;
+            return;
+        }
+        PositionTreeNode*position_with_same_hash =
+            GET_POSITION_TREE_NODE(*index_of_position_with_same_hash);
+        if (position_with_same_hash->position_hash != node->position_hash ||
+            memcmp(&node->position, &position_with_same_hash->position, sizeof(node->position)))
+        {
+            index_of_position_with_same_hash =
+                &position_with_same_hash->index_of_next_position_with_same_hash;
+        }
+        else
+        {
+            node->is_canonical = false;
+            node->next_transposion_index = position_with_same_hash->next_transposion_index;
+            position_with_same_hash->next_transposion_index = position->node_index;
+            node->evaluation = position_with_same_hash->evaluation;
+            node->evaluation_has_been_propagated_to_parents = true;
+            return;
+        }
+    }
+}
+
+void decompress_position(Position*out, NodeIndex position_tree_node_index)
+{
+    unpack_position(out, &GET_POSITION_TREE_NODE(position_tree_node_index)->position);
+    out->node_index = position_tree_node_index;
+}
+#endif
+
+int32_t min32(int32_t a, int32_t b)
+{
+    if (a < b)
+    {
+        return a;
+    }
+    return b;
+}
+
+uint32_t max32(uint32_t a, uint32_t b)
+{
+    if (a > b)
+    {
+        return a;
+    }
+    return b;
+}
+
+int16_t get_king_safety_evaluation(Position*position)
+{
+    uint8_t*white_king_distances = g_king_distances
+        [position->pieces[PLAYER_PIECES_INDEX(PLAYER_INDEX_WHITE)].square_index];
+    uint8_t*black_king_distances = g_king_distances
+        [position->pieces[PLAYER_PIECES_INDEX(PLAYER_INDEX_BLACK)].square_index];
+    int8_t*white_control_counts = position->square_control_counts[PLAYER_INDEX_WHITE];
+    int8_t*black_control_counts = position->square_control_counts[PLAYER_INDEX_BLACK];
+#if defined(__AVX2__)
+    __m256i out = _mm256_setzero_si256();
+    for (uint8_t square_index = 0; square_index < 64; square_index += 16)
+    {
+        __m256i control_counts = _mm256_add_epi16(
+            _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i*)(white_control_counts + square_index))),
+            _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i*)(black_control_counts + square_index))));
+        __m256i king_distances = _mm256_add_epi16(
+            _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(white_king_distances + square_index))),
+            _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(black_king_distances + square_index))));
+        __m256i weights = _mm256_sub_epi16(_mm256_set1_epi16(14), king_distances);
+        __m256i abs_counts = _mm256_abs_epi16(control_counts);
+        __m256i terms = _mm256_sub_epi16(_mm256_slli_epi16(abs_counts, 4), _mm256_srai_epi16(
+            _mm256_mullo_epi16(abs_counts, _mm256_sub_epi16(abs_counts, _mm256_set1_epi16(1))), 1));
+        out = _mm256_add_epi32(out,
+            _mm256_madd_epi16(weights, _mm256_sign_epi16(terms, control_counts)));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(out), _mm256_extracti128_si256(out, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b01001110));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b10110001));
+    return _mm_cvtsi128_si32(sum);
+#elif defined(__SSE4_1__)
+    __m128i out = _mm_setzero_si128();
+    for (uint8_t square_index = 0; square_index < 64; square_index += 8)
+    {
+        __m128i control_counts = _mm_add_epi16(
+            _mm_cvtepi8_epi16(_mm_loadl_epi64((__m128i*)(white_control_counts + square_index))),
+            _mm_cvtepi8_epi16(_mm_loadl_epi64((__m128i*)(black_control_counts + square_index))));
+        __m128i king_distances = _mm_add_epi16(
+            _mm_cvtepu8_epi16(_mm_loadl_epi64((__m128i*)(white_king_distances + square_index))),
+            _mm_cvtepu8_epi16(_mm_loadl_epi64((__m128i*)(black_king_distances + square_index))));
+        __m128i weights = _mm_sub_epi16(_mm_set1_epi16(14), king_distances);
+        __m128i abs_counts = _mm_abs_epi16(control_counts);
+        __m128i terms = _mm_sub_epi16(_mm_slli_epi16(abs_counts, 4), _mm_srai_epi16(
+            _mm_mullo_epi16(abs_counts, _mm_sub_epi16(abs_counts, _mm_set1_epi16(1))), 1));
+        out = _mm_add_epi32(out, _mm_madd_epi16(weights, _mm_sign_epi16(terms, control_counts)));
+    }
+    out = _mm_add_epi32(out, _mm_shuffle_epi32(out, 0b01001110));
+    out = _mm_add_epi32(out, _mm_shuffle_epi32(out, 0b10110001));
+    return _mm_cvtsi128_si32(out);
+#else
+    int16_t out = 0;
+    for (uint8_t square_index = 0; square_index < 64; ++square_index)
+    {
+        int16_t control_count =
+            white_control_counts[square_index] + black_control_counts[square_index];
+        int16_t abs_count;
+        int16_t sign;
+        if (control_count < 0)
+        {
+            abs_count = -control_count;
+            sign = -1;
+        }
+        else
+        {
+            abs_count = control_count;
+            sign = 1;
+        }
+        out += (14 - (white_king_distances[square_index] + black_king_distances[square_index])) *
+            sign * (16 * abs_count - (abs_count * (abs_count - 1)) / 2);
+    }
+    return out;
+#endif
+}
+
+int16_t get_material_evaluation(Position*position)
+{
+    int16_t out = 0;
+    for (PieceType piece_type = 0; piece_type < PIECE_TYPE_COUNT; ++piece_type)
+    {
+        uint64_t piece_type_mask = position->piece_type_masks[piece_type];
+        out += 32 * g_piece_values[piece_type] *
+            (get_set_bit_count(piece_type_mask & position->player_masks[PLAYER_INDEX_WHITE]) -
+                get_set_bit_count(piece_type_mask & position->player_masks[PLAYER_INDEX_BLACK]));
+    }
+    return out;
+}
+
+void link_move_node(Position*position, NodeIndex move_node_index, Move move, int16_t*evaluation)
+{
+    PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
+    move_node->parent_index = position->node_index;
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(position->node_index);
+    if (node->is_leaf)
+    {
+        SET_PREVIOUS_LEAF_INDEX(move_node, GET_PREVIOUS_LEAF_INDEX(node));
+        SET_NEXT_LEAF_INDEX(move_node, GET_NEXT_LEAF_INDEX(node));
+        if (GET_NEXT_LEAF_INDEX(move_node) != NULL_POSITION_TREE_NODE)
+        {
+            SET_PREVIOUS_LEAF_INDEX(GET_POSITION_TREE_NODE(GET_NEXT_LEAF_INDEX(move_node)),
+                move_node_index);
+        }
+        node->is_leaf = false;
+        SET_BEST_MOVE_NODE_INDEX(node, move_node_index);
+        move_node->next_move_node_index = NULL_POSITION_TREE_NODE;
+    }
+    else
+    {
+        PositionTreeNode*next_move_node = GET_POSITION_TREE_NODE(GET_FIRST_MOVE_NODE_INDEX(node));
+        if (next_move_node->is_leaf)
+        {
+            SET_PREVIOUS_LEAF_INDEX(move_node, GET_PREVIOUS_LEAF_INDEX(next_move_node));
+            SET_NEXT_LEAF_INDEX(move_node, GET_FIRST_MOVE_NODE_INDEX(node));
+            SET_PREVIOUS_LEAF_INDEX(next_move_node, move_node_index);
+        }
+        else
+        {
+            SET_PREVIOUS_LEAF_INDEX(move_node, NULL_POSITION_TREE_NODE);
+            SET_NEXT_LEAF_INDEX(move_node, g_first_leaf_index);
+            SET_PREVIOUS_LEAF_INDEX(GET_POSITION_TREE_NODE(g_first_leaf_index), move_node_index);
+        }
+        move_node->next_move_node_index = GET_FIRST_MOVE_NODE_INDEX(node);
+    }
+    if (GET_PREVIOUS_LEAF_INDEX(move_node) == NULL_POSITION_TREE_NODE)
+    {
+        g_first_leaf_index = move_node_index;
+    }
+    else
+    {
+        SET_NEXT_LEAF_INDEX(GET_POSITION_TREE_NODE(GET_PREVIOUS_LEAF_INDEX(move_node)),
+            move_node_index);
+    }
+    SET_FIRST_MOVE_NODE_INDEX(node, move_node_index);
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+    move_node->move = move;
+#endif
+    MoveUndo undo;
+    make_move(position, move, &undo);
+    NodeIndex node_index = position->node_index;
+    position->node_index = move_node_index;
+    if (evaluation)
+    {
+        compress_position_to_node(position, *evaluation);
+    }
+    else
+    {
+        compress_position_to_node(position,
+            get_king_safety_evaluation(position) + get_material_evaluation(position));
+    }
+    position->node_index = node_index;
+    unmake_move(position, move, &undo);
+}
+
+void add_move(Position*position, Move move, int16_t*evaluation)
+{
+    link_move_node(position, allocate_position_tree_node(), move, evaluation);
+}
+
+void remove_new_move_nodes(PositionTreeNode*node, NodeIndex first_new_node_index)
+{
+    while (g_index_of_first_free_position_tree_node > first_new_node_index)
+    {
+        --g_index_of_first_free_position_tree_node;
+        NodeIndex move_node_index = g_index_of_first_free_position_tree_node;
+        PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
+        NodeIndex*index_of_position_with_same_hash =
+            g_tree_position_buckets + get_tree_position_bucket_index(move_node->position_hash);
+        while (*index_of_position_with_same_hash != move_node_index)
+        {
+            PositionTreeNode*position_with_same_hash =
+                GET_POSITION_TREE_NODE(*index_of_position_with_same_hash);
+            if (position_with_same_hash->next_transposion_index == move_node_index)
+            {
+                index_of_position_with_same_hash =
+                    &position_with_same_hash->next_transposion_index;
+                break;
+            }
+            index_of_position_with_same_hash =
+                &position_with_same_hash->index_of_next_position_with_same_hash;
+        }
+        if (move_node->is_canonical)
+        {
+            *index_of_position_with_same_hash = move_node->index_of_next_position_with_same_hash;
+        }
+        else
+        {
+            *index_of_position_with_same_hash = move_node->next_transposion_index;
+        }
+        NodeIndex previous_leaf_index = GET_PREVIOUS_LEAF_INDEX(move_node);
+        NodeIndex next_leaf_index = GET_NEXT_LEAF_INDEX(move_node);
+        NodeIndex previous_link_index = previous_leaf_index;
+        NodeIndex next_link_index = next_leaf_index;
+        if (move_node->next_move_node_index == NULL_POSITION_TREE_NODE)
+        {
+            node->is_leaf = true;
+            SET_PREVIOUS_LEAF_INDEX(node, previous_leaf_index);
+            SET_NEXT_LEAF_INDEX(node, next_leaf_index);
+            previous_link_index = move_node->parent_index;
+            next_link_index = move_node->parent_index;
+        }
+        else
+        {
+            SET_FIRST_MOVE_NODE_INDEX(node, move_node->next_move_node_index);
+        }
+        if (previous_leaf_index == NULL_POSITION_TREE_NODE)
+        {
+            g_first_leaf_index = next_link_index;
+        }
+        else
+        {
+            SET_NEXT_LEAF_INDEX(GET_POSITION_TREE_NODE(previous_leaf_index), next_link_index);
+        }
+        if (next_leaf_index != NULL_POSITION_TREE_NODE)
+        {
+            SET_PREVIOUS_LEAF_INDEX(GET_POSITION_TREE_NODE(next_leaf_index), previous_link_index);
+        }
+    }
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+    if (g_replayed_position_node_index != NULL_POSITION_TREE_NODE &&
+        g_replayed_position_node_index >= first_new_node_index)
+    {
+        g_replayed_position_node_index = NULL_POSITION_TREE_NODE;
+    }
+#endif
+}
+
+void add_piece_moves(Position*position, Move*moves, uint8_t*move_count, uint8_t piece_index,
+    uint64_t destination_mask)
+{
+    uint8_t origin_square_index = position->pieces[piece_index].square_index;
+    while (destination_mask)
+    {
+        uint32_t destination_square_index;
+        BIT_SCAN_FORWARD_64(&destination_square_index, destination_mask);
+        destination_mask &= destination_mask - 1;
+        moves[*move_count] = MOVE(origin_square_index, destination_square_index, MOVE_FLAG_NORMAL);
+        ++*move_count;
+    }
+}
+
+void add_capture_candidate(Position*position, uint32_t*candidates, uint8_t*candidate_count,
+    Move move)
+{
+    uint8_t flag = MOVE_FLAG(move);
+    int16_t score =
+        -g_piece_values[position->pieces[position->squares[MOVE_ORIGIN(move)]].piece_type];
+    if (flag == MOVE_FLAG_EN_PASSANT)
+    {
+        score += 16 * g_piece_values[PIECE_PAWN];
+    }
+    else if (position->squares[MOVE_DESTINATION(move)] != NULL_PIECE)
+    {
+        score += 16 * g_piece_values
+            [position->pieces[position->squares[MOVE_DESTINATION(move)]].piece_type];
+    }
+    if (flag >= MOVE_FLAG_PROMOTION)
+    {
+        score += 16 * g_piece_values[g_promotion_options[flag - MOVE_FLAG_PROMOTION]];
+    }
+    candidates[*candidate_count] = ((uint32_t)score << 16) | move;
+    ++*candidate_count;
+}
+
+void add_capture_candidates(Position*position, uint32_t*candidates, uint8_t*candidate_count,
+    uint8_t piece_index, uint64_t destination_mask)
+{
+    Piece piece = position->pieces[piece_index];
+    uint64_t promotion_mask = 0;
+    if (piece.piece_type == PIECE_PAWN)
+    {
+        promotion_mask = RANK_MASK(KING_RANK(!PLAYER_INDEX(piece_index)));
+    }
+    while (destination_mask)
+    {
+        uint32_t destination_square_index;
+        BIT_SCAN_FORWARD_64(&destination_square_index, destination_mask);
+        destination_mask &= destination_mask - 1;
+        if (promotion_mask & SQUARE_MASK(destination_square_index))
+        {
+            for (uint8_t i = 0; i < ARRAY_COUNT(g_promotion_options); ++i)
+            {
+                add_capture_candidate(position, candidates, candidate_count,
+                    MOVE(piece.square_index, destination_square_index, MOVE_FLAG_PROMOTION + i));
+            }
+        }
+        else
+        {
+            add_capture_candidate(position, candidates, candidate_count,
+                MOVE(piece.square_index, destination_square_index, MOVE_FLAG_NORMAL));
+        }
+    }
+}
+
+bool en_passant_move_is_legal(Position*position, Move move)
+{
+    MoveUndo undo;
+    make_move(position, move, &undo);
+    bool king_hangs = king_is_attacked(position, !position->active_player_index);
+    unmake_move(position, move, &undo);
+    return !king_hangs;
+}
+
+void propagate_evaluation_to_transpositions(PositionTreeNode*node)
+{
+    ASSERT(node->is_canonical);
+    int16_t evaluation = node->evaluation;
+    while (node->next_transposion_index != NULL_POSITION_TREE_NODE)
+    {
+        NodeIndex transposition_index = node->next_transposion_index;
+        node = GET_POSITION_TREE_NODE(transposition_index);
+        node->evaluation = evaluation;
+        if (node->evaluation_has_been_propagated_to_parents)
+        {
+            node->evaluation_has_been_propagated_to_parents = false;
+            node->next_pending_transposition_index = g_first_pending_transposition_index;
+            g_first_pending_transposition_index = transposition_index;
+        }
+    }
+}
+
+bool evaluation_is_better(int16_t evaluation, int16_t other_evaluation, uint8_t player_index)
+{
+    if (player_index == PLAYER_INDEX_WHITE)
+    {
+        return evaluation > other_evaluation;
+    }
+    return evaluation < other_evaluation;
+}
+
+bool evaluation_is_within_skipped_move_margin(int16_t evaluation, int16_t best_evaluation,
+    uint8_t player_index)
+{
+    int32_t evaluation_loss = best_evaluation - evaluation;
+    if (player_index == PLAYER_INDEX_BLACK)
+    {
+        evaluation_loss = -evaluation_loss;
+    }
+    return evaluation_loss <= g_skipped_move_margin;
+}
+
+bool skipped_moves_are_due(PositionTreeNode*node)
+{
+    return node->has_skipped_moves && evaluation_is_within_skipped_move_margin(
+        node->best_skipped_move_evaluation, node->evaluation, NODE_ACTIVE_PLAYER_INDEX(node));
+}
+
+int16_t update_best_move(PositionTreeNode*node)
+{
+    int16_t out = PLAYER_WIN(!NODE_ACTIVE_PLAYER_INDEX(node));
+    NodeIndex move_node_index = GET_FIRST_MOVE_NODE_INDEX(node);
+    SET_BEST_MOVE_NODE_INDEX(node, move_node_index);
+    while (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
+        if (evaluation_is_better(move_node->evaluation, out, NODE_ACTIVE_PLAYER_INDEX(node)))
+        {
+            out = move_node->evaluation;
+            SET_BEST_MOVE_NODE_INDEX(node, move_node_index);
+        }
+        move_node_index = move_node->next_move_node_index;
+    }
+    return out;
+}
+
+void back_up_evaluation(PositionTreeNode*node)
+{
+    node->evaluation_has_been_propagated_to_parents = true;
+    while (node->parent_index != NULL_POSITION_TREE_NODE)
+    {
+        PositionTreeNode*move_node = node;
+        NodeIndex move_node_index = move_node - g_position_tree_nodes;
+        node = GET_POSITION_TREE_NODE(node->parent_index);
+        int16_t new_evaluation;
+        if (evaluation_is_better(move_node->evaluation, node->evaluation,
+            NODE_ACTIVE_PLAYER_INDEX(node)))
+        {
+            new_evaluation = move_node->evaluation;
+            SET_BEST_MOVE_NODE_INDEX(node, move_node_index);
+        }
+        else if (GET_BEST_MOVE_NODE_INDEX(node) == move_node_index)
+        {
+            new_evaluation = update_best_move(node);
+        }
+        else
+        {
+            return;
+        }
+        if (new_evaluation == node->evaluation)
+        {
+            return;
+        }
+        node->evaluation = new_evaluation;
+        propagate_evaluation_to_transpositions(node);
+        if (skipped_moves_are_due(node))
+        {
+            NodeIndex node_index = node - g_position_tree_nodes;
+            push_frontier_node(node_index, get_frontier_priority(node_index));
+        }
+    }
+}
+
+void propagate_evaluation_to_parents(PositionTreeNode*node)
+{
+    back_up_evaluation(node);
+    while (g_first_pending_transposition_index != NULL_POSITION_TREE_NODE)
+    {
+        node = GET_POSITION_TREE_NODE(g_first_pending_transposition_index);
+        g_first_pending_transposition_index = node->next_pending_transposition_index;
+        back_up_evaluation(node);
+    }
+}
+
+uint8_t get_moves_of_stage(Position*position, MoveStage stage, Move*moves)
+{
+    uint8_t player_index = position->active_player_index;
+    uint64_t own_piece_mask = position->player_masks[player_index];
+    uint64_t enemy_piece_mask = position->player_masks[!player_index];
+    uint64_t occupancy = OCCUPANCY(position);
+    uint8_t player_pieces_index = PLAYER_PIECES_INDEX(player_index);
+    uint8_t king_square_index = position->pieces[player_pieces_index].square_index;
+    uint64_t checker_mask =
+        get_attacker_mask(position, king_square_index, !player_index, occupancy);
+    uint64_t evasion_mask = UINT64_MAX;
+    if (checker_mask)
+    {
+        if (checker_mask & (checker_mask - 1))
+        {
+            evasion_mask = 0;
+        }
+        else
+        {
+            uint32_t checker_square_index;
+            BIT_SCAN_FORWARD_64(&checker_square_index, checker_mask);
+            evasion_mask =
+                g_squares_between_masks[king_square_index][checker_square_index] | checker_mask;
+        }
+    }
+    uint64_t pin_masks[16];
+    get_blocker_masks(position, player_index, pin_masks);
+    uint64_t check_masks[PIECE_TYPE_COUNT];
+    uint64_t discovery_masks[16];
+    if (stage != MOVE_STAGE_CAPTURES)
+    {
+        get_check_masks(position, check_masks);
+        get_blocker_masks(position, !player_index, discovery_masks);
+    }
+    uint8_t move_count = 0;
+    uint32_t capture_candidates[MAX_MOVE_COUNT];
+    uint8_t capture_candidate_count = 0;
+    uint8_t max_piece_index = player_pieces_index + 16;
+    for (uint8_t piece_index = player_pieces_index; piece_index < max_piece_index; ++piece_index)
+    {
+        Piece piece = position->pieces[piece_index];
+        if (piece.square_index == NULL_SQUARE)
+        {
+            continue;
+        }
+        uint64_t legal_destination_mask =
+            ~own_piece_mask & evasion_mask & pin_masks[piece_index - player_pieces_index];
+        uint64_t stage_destination_mask = enemy_piece_mask;
+        if (stage != MOVE_STAGE_CAPTURES)
+        {
+            uint64_t check_destination_mask = check_masks[piece.piece_type] |
+                ~discovery_masks[piece_index - player_pieces_index];
+            if (stage == MOVE_STAGE_CHECKS)
+            {
+                stage_destination_mask = ~occupancy & check_destination_mask;
+            }
+            else
+            {
+                stage_destination_mask = ~occupancy & ~check_destination_mask;
+            }
+        }
+        switch (piece.piece_type)
+        {
+        case PIECE_KING:
+        {
+            uint64_t king_destination_mask =
+                g_king_attack_masks[piece.square_index] & ~own_piece_mask & stage_destination_mask;
+            uint64_t candidate_mask = king_destination_mask;
+            while (candidate_mask)
+            {
+                uint32_t destination_square_index;
+                BIT_SCAN_FORWARD_64(&destination_square_index, candidate_mask);
+                candidate_mask &= candidate_mask - 1;
+                if (square_is_attacked(position, destination_square_index, !player_index,
+                    occupancy ^ SQUARE_MASK(piece.square_index)))
+                {
+                    king_destination_mask ^= SQUARE_MASK(destination_square_index);
+                }
+            }
+            if (stage == MOVE_STAGE_CAPTURES)
+            {
+                add_capture_candidates(position, capture_candidates, &capture_candidate_count,
+                    piece_index, king_destination_mask);
+                break;
+            }
+            add_piece_moves(position, moves, &move_count, piece_index, king_destination_mask);
+            if (checker_mask || stage != MOVE_STAGE_QUIETS)
+            {
+                break;
+            }
+            if (!(position->castling_rights_lost & (1 << (player_index << 1))) &&
+                position->squares[piece.square_index - 1] == NULL_PIECE &&
+                position->squares[piece.square_index - 2] == NULL_PIECE &&
+                position->squares[piece.square_index - 3] == NULL_PIECE &&
+                !square_is_attacked(position, piece.square_index - 1, !player_index, occupancy) &&
+                !square_is_attacked(position, piece.square_index - 2, !player_index, occupancy))
+            {
+                moves[move_count] =
+                    MOVE(piece.square_index, piece.square_index - 2, MOVE_FLAG_CASTLE);
+                ++move_count;
+            }
+            if (!(position->castling_rights_lost & (0b10 << (player_index << 1))) &&
+                position->squares[piece.square_index + 1] == NULL_PIECE &&
+                position->squares[piece.square_index + 2] == NULL_PIECE &&
+                !square_is_attacked(position, piece.square_index + 1, !player_index, occupancy) &&
+                !square_is_attacked(position, piece.square_index + 2, !player_index, occupancy))
+            {
+                moves[move_count] =
+                    MOVE(piece.square_index, piece.square_index + 2, MOVE_FLAG_CASTLE);
+                ++move_count;
+            }
+            break;
+        }
+        case PIECE_PAWN:
+        {
+            int8_t forward_delta = FORWARD_DELTA(player_index);
+            uint8_t destination_square_index = piece.square_index + forward_delta * FILE_COUNT;
+            uint64_t destination_square_mask = SQUARE_MASK(destination_square_index);
+            bool push_is_promotion = RANK(destination_square_index) == KING_RANK(!player_index);
+            if (stage == MOVE_STAGE_CAPTURES)
+            {
+                add_capture_candidates(position, capture_candidates, &capture_candidate_count,
+                    piece_index, enemy_piece_mask &
+                    g_pawn_attack_masks[player_index][piece.square_index] &
+                    legal_destination_mask);
+                if (position->en_passant_file < FILE_COUNT)
+                {
+                    uint8_t en_passant_square_index = SQUARE_INDEX(EN_PASSANT_RANK(player_index,
+                        forward_delta) + forward_delta, position->en_passant_file);
+                    Move move =
+                        MOVE(piece.square_index, en_passant_square_index, MOVE_FLAG_EN_PASSANT);
+                    if ((g_pawn_attack_masks[player_index][piece.square_index] &
+                        SQUARE_MASK(en_passant_square_index)) &&
+                        en_passant_move_is_legal(position, move))
+                    {
+                        add_capture_candidate(position, capture_candidates,
+                            &capture_candidate_count, move);
+                    }
+                }
+                if (push_is_promotion && !(occupancy & destination_square_mask))
+                {
+                    add_capture_candidates(position, capture_candidates,
+                        &capture_candidate_count, piece_index,
+                        destination_square_mask & legal_destination_mask);
+                }
+                break;
+            }
+            if (push_is_promotion || (occupancy & destination_square_mask))
+            {
+                break;
+            }
+            if (destination_square_mask & legal_destination_mask & stage_destination_mask)
+            {
+                moves[move_count] =
+                    MOVE(piece.square_index, destination_square_index, MOVE_FLAG_NORMAL);
+                ++move_count;
+            }
+            destination_square_index += forward_delta * FILE_COUNT;
+            destination_square_mask = SQUARE_MASK(destination_square_index);
+            if (RANK(piece.square_index) == KING_RANK(player_index) + forward_delta &&
+                !(occupancy & destination_square_mask) &&
+                (destination_square_mask & legal_destination_mask & stage_destination_mask))
+            {
+                moves[move_count] =
+                    MOVE(piece.square_index, destination_square_index, MOVE_FLAG_DOUBLE_PUSH);
+                ++move_count;
+            }
+            break;
+        }
+        default:
+        {
+            uint64_t destination_mask = get_piece_attack_mask(position, piece_index) &
+                legal_destination_mask & stage_destination_mask;
+            if (stage == MOVE_STAGE_CAPTURES)
+            {
+                add_capture_candidates(position, capture_candidates, &capture_candidate_count,
+                    piece_index, destination_mask);
+            }
+            else
+            {
+                add_piece_moves(position, moves, &move_count, piece_index, destination_mask);
+            }
+        }
+        }
+    }
+    for (uint8_t i = 1; i < capture_candidate_count; ++i)
+    {
+        uint32_t candidate = capture_candidates[i];
+        uint8_t j = i;
+        while (j && capture_candidates[j - 1] < candidate)
+        {
+            capture_candidates[j] = capture_candidates[j - 1];
+            --j;
+        }
+        capture_candidates[j] = candidate;
+    }
+    for (uint8_t i = 0; i < capture_candidate_count; ++i)
+    {
+        moves[move_count] = (Move)capture_candidates[i];
+        ++move_count;
+    }
+    return move_count;
+}
+
+int16_t get_capture_gain(Position*position, Move move)
+{
+    uint8_t flag = MOVE_FLAG(move);
+    int16_t out = 0;
+    if (flag == MOVE_FLAG_EN_PASSANT)
+    {
+        out = g_piece_values[PIECE_PAWN];
+    }
+    else if (position->squares[MOVE_DESTINATION(move)] != NULL_PIECE)
+    {
+        out = g_piece_values
+            [position->pieces[position->squares[MOVE_DESTINATION(move)]].piece_type];
+    }
+    if (flag >= MOVE_FLAG_PROMOTION)
+    {
+        out += g_piece_values[g_promotion_options[flag - MOVE_FLAG_PROMOTION]] -
+            g_piece_values[PIECE_PAWN];
+    }
+    return 32 * out;
+}
+
+bool capture_loses_material(Position*position, Move move)
+{
+    uint8_t destination_square_index = MOVE_DESTINATION(move);
+    int16_t attacker_value =
+        g_piece_values[position->pieces[position->squares[MOVE_ORIGIN(move)]].piece_type];
+    int16_t victim_value = 0;
+    if (position->squares[destination_square_index] != NULL_PIECE)
+    {
+        victim_value = g_piece_values
+            [position->pieces[position->squares[destination_square_index]].piece_type];
+    }
+    else if (MOVE_FLAG(move) == MOVE_FLAG_EN_PASSANT)
+    {
+        victim_value = g_piece_values[PIECE_PAWN];
+    }
+    return attacker_value >= victim_value && position->square_control_counts
+        [!position->active_player_index][destination_square_index];
+}
+
+int16_t get_quiescence_evaluation(Position*position, int16_t alpha, int16_t beta,
+    int16_t king_safety_evaluation)
+{
+    int16_t evaluation = king_safety_evaluation + get_material_evaluation(position);
+    if (position->active_player_index == PLAYER_INDEX_BLACK)
+    {
+        evaluation = -evaluation;
+    }
+    if (evaluation >= beta)
+    {
+        return beta;
+    }
+    if (evaluation > alpha)
+    {
+        alpha = evaluation;
+    }
+    int32_t stand_pat_evaluation = evaluation;
+    Move moves[MAX_MOVE_COUNT];
+    uint8_t move_count = get_moves_of_stage(position, MOVE_STAGE_CAPTURES, moves);
+    for (uint8_t i = 0; i < move_count; ++i)
+    {
+        if (stand_pat_evaluation + get_capture_gain(position, moves[i]) +
+            QUIESCENCE_DELTA_MARGIN <= alpha || capture_loses_material(position, moves[i]))
+        {
+            continue;
+        }
+        MoveUndo undo;
+        make_move(position, moves[i], &undo);
+        evaluation = -get_quiescence_evaluation(position, -beta, -alpha, king_safety_evaluation);
+        unmake_move(position, moves[i], &undo);
+        if (evaluation >= beta)
+        {
+            return beta;
+        }
+        if (evaluation > alpha)
+        {
+            alpha = evaluation;
+        }
+    }
+    return alpha;
+}
+
+int16_t get_leaf_evaluation(Position*position)
+{
+    int16_t evaluation = get_quiescence_evaluation(position, -INT16_MAX, INT16_MAX,
+        get_king_safety_evaluation(position));
+    if (position->active_player_index == PLAYER_INDEX_BLACK)
+    {
+        return -evaluation;
+    }
+    return evaluation;
+}
+
+void get_move_evaluations(Position*position, Move*moves, int16_t*evaluations,
+    uint8_t move_count)
+{
+    for (uint8_t i = 0; i < move_count; ++i)
+    {
+        MoveUndo undo;
+        make_move(position, moves[i], &undo);
+        evaluations[i] = get_leaf_evaluation(position);
+        unmake_move(position, moves[i], &undo);
+    }
+}
+
+uint8_t get_staged_moves(Position*position, uint8_t*next_move_stage, Move*moves,
+    int16_t*evaluations)
+{
+    uint8_t move_count = 0;
+    while (!move_count && *next_move_stage != MOVE_STAGE_DONE)
+    {
+        move_count = get_moves_of_stage(position, *next_move_stage, moves);
+        ++*next_move_stage;
+    }
+    if (evaluations)
+    {
+        get_move_evaluations(position, moves, evaluations, move_count);
+    }
+    return move_count;
+}
+
+uint8_t get_skipped_moves(Position*position, uint8_t next_move_stage, Move*moves,
+    int16_t*evaluations)
+{
+    uint8_t move_count = 0;
+    for (uint8_t stage = MOVE_STAGE_CAPTURES; stage < next_move_stage; ++stage)
+    {
+        move_count += get_moves_of_stage(position, stage, moves + move_count);
+    }
+    get_move_evaluations(position, moves, evaluations, move_count);
+    return move_count;
+}
+
+uint8_t skip_moves_outside_margin(PositionTreeNode*node, Position*position, Move*moves,
+    int16_t*evaluations, uint8_t move_count)
+{
+    if (!g_skipped_move_margin || !evaluations || node->parent_index == NULL_POSITION_TREE_NODE)
+    {
+        return move_count;
+    }
+    int16_t best_evaluation =
+        node->is_leaf ? PLAYER_WIN(!position->active_player_index) : node->evaluation;
+    for (uint8_t i = 0; i < move_count; ++i)
+    {
+        if (evaluation_is_better(evaluations[i], best_evaluation, position->active_player_index))
+        {
+            best_evaluation = evaluations[i];
+        }
+    }
+    uint8_t kept_move_count = 0;
+    for (uint8_t i = 0; i < move_count; ++i)
+    {
+        if (evaluation_is_within_skipped_move_margin(evaluations[i], best_evaluation,
+            position->active_player_index))
+        {
+            moves[kept_move_count] = moves[i];
+            evaluations[kept_move_count] = evaluations[i];
+            ++kept_move_count;
+        }
+        else if (!node->has_skipped_moves || evaluation_is_better(evaluations[i],
+            node->best_skipped_move_evaluation, position->active_player_index))
+        {
+            node->has_skipped_moves = true;
+            node->best_skipped_move_evaluation = evaluations[i];
+        }
+    }
+    return kept_move_count;
+}
+
+void update_expanded_node(Position*position, uint8_t next_move_stage, bool node_was_leaf,
+    NodeIndex first_new_node_index, NodeIndex end_node_index)
+{
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(position->node_index);
+    node->next_move_stage = next_move_stage;
+    int16_t new_evaluation;
+    if (node->is_leaf)
+    {
+        if (king_is_attacked(position, position->active_player_index))
+        {
+            new_evaluation = PLAYER_WIN(!position->active_player_index);
+        }
+        else
+        {
+            new_evaluation = 0;
+        }
+    }
+    else
+    {
+        new_evaluation = node->evaluation;
+        if (node_was_leaf)
+        {
+            new_evaluation = PLAYER_WIN(!position->active_player_index);
+        }
+        for (NodeIndex move_node_index = first_new_node_index; move_node_index < end_node_index;
+            ++move_node_index)
+        {
+            PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
+            if (evaluation_is_better(move_node->evaluation, new_evaluation,
+                position->active_player_index))
+            {
+                new_evaluation = move_node->evaluation;
+                SET_BEST_MOVE_NODE_INDEX(node, move_node_index);
+            }
+        }
+    }
+    if (new_evaluation == node->evaluation)
+    {
+        return;
+    }
+    node->evaluation = new_evaluation;
+    propagate_evaluation_to_transpositions(node);
+    propagate_evaluation_to_parents(node);
+}
+
+void add_staged_moves(Position*position, uint8_t move_stage, uint8_t next_move_stage,
+    Move*moves, int16_t*evaluations, volatile uint8_t move_count)
+{
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(position->node_index);
+    if (node->next_move_stage != move_stage)
+    {
+        return;
+    }
+    NodeIndex first_new_node_index = g_index_of_first_free_position_tree_node;
+    if (setjmp(out_of_memory_jump_buffer))
+    {
+        remove_new_move_nodes(node, first_new_node_index);
+        return;
+    }
+    bool node_was_leaf = node->is_leaf;
+    move_count = skip_moves_outside_margin(node, position, moves, evaluations, move_count);
+    while (move_count)
+    {
+        --move_count;
+        add_move(position, moves[move_count], evaluations ? evaluations + move_count : 0);
+    }
+    update_expanded_node(position, next_move_stage, node_was_leaf, first_new_node_index,
+        g_index_of_first_free_position_tree_node);
+}
+
+void add_reserved_moves(Position*position, uint8_t next_move_stage, Move*moves,
+    int16_t*evaluations, NodeIndex first_move_node_index, uint8_t move_count)
+{
+    bool node_was_leaf = GET_POSITION_TREE_NODE(position->node_index)->is_leaf;
+    NodeIndex move_node_index = first_move_node_index;
+    while (move_count)
+    {
+        --move_count;
+        init_position_tree_node(GET_POSITION_TREE_NODE(move_node_index));
+        link_move_node(position, move_node_index, moves[move_count], evaluations + move_count);
+        ++move_node_index;
+    }
+    update_expanded_node(position, next_move_stage, node_was_leaf, first_move_node_index,
+        move_node_index);
+}
+
+void get_moves(Position*position)
+{
+    Move moves[MAX_MOVE_COUNT];
+    int16_t evaluations[MAX_MOVE_COUNT];
+    uint8_t move_stage = GET_POSITION_TREE_NODE(position->node_index)->next_move_stage;
+    uint8_t next_move_stage = move_stage;
+    uint8_t move_count = get_staged_moves(position, &next_move_stage, moves, evaluations);
+    add_staged_moves(position, move_stage, next_move_stage, moves, evaluations, move_count);
+}
+
+bool move_node_exists(Position*position, Move move)
+{
+    MoveUndo undo;
+    make_move(position, move, &undo);
+    uint64_t zobrist_key = position->zobrist_key;
+    unmake_move(position, move, &undo);
+    NodeIndex move_node_index =
+        GET_FIRST_MOVE_NODE_INDEX(GET_POSITION_TREE_NODE(position->node_index));
+    while (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
+        if (move_node->position_hash == (uint32_t)zobrist_key)
+        {
+            Position move_position;
+            decompress_position(&move_position, move_node_index);
+            if (move_position.zobrist_key == zobrist_key)
+            {
+                return true;
+            }
+        }
+        move_node_index = move_node->next_move_node_index;
+    }
+    return false;
+}
+
+void add_skipped_moves(Position*position, uint8_t next_move_stage, Move*moves,
+    int16_t*evaluations, uint8_t move_count)
+{
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(position->node_index);
+    if (node->next_move_stage != next_move_stage)
+    {
+        push_frontier_node(position->node_index, get_frontier_priority(position->node_index));
+        return;
+    }
+    uint8_t new_move_count = 0;
+    for (uint8_t i = 0; i < move_count; ++i)
+    {
+        if (!move_node_exists(position, moves[i]))
+        {
+            moves[new_move_count] = moves[i];
+            evaluations[new_move_count] = evaluations[i];
+            ++new_move_count;
+        }
+    }
+    node->has_skipped_moves = false;
+    add_staged_moves(position, next_move_stage, next_move_stage, moves, evaluations,
+        new_move_count);
+}
+
+void materialize_skipped_moves(Position*position)
+{
+    Move moves[MAX_MOVE_COUNT];
+    int16_t evaluations[MAX_MOVE_COUNT];
+    uint8_t next_move_stage = GET_POSITION_TREE_NODE(position->node_index)->next_move_stage;
+    uint8_t move_count = get_skipped_moves(position, next_move_stage, moves, evaluations);
+    add_skipped_moves(position, next_move_stage, moves, evaluations, move_count);
+}
+
+void get_deferred_moves_of_parent(PositionTreeNode*node)
+{
+    if (node->parent_index == NULL_POSITION_TREE_NODE)
+    {
+        return;
+    }
+    PositionTreeNode*parent = GET_POSITION_TREE_NODE(node->parent_index);
+    if (parent->next_move_stage == MOVE_STAGE_DONE)
+    {
+        return;
+    }
+    NodeIndex move_node_index = GET_FIRST_MOVE_NODE_INDEX(parent);
+    while (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
+        if (move_node->is_canonical && move_node->is_leaf &&
+            move_node->next_move_stage != MOVE_STAGE_DONE)
+        {
+            return;
+        }
+        move_node_index = move_node->next_move_node_index;
+    }
+    Position position;
+    decompress_position(&position, node->parent_index);
+    get_moves(&position);
+}
+
+bool subtree_is_garbage(NodeIndex node_index, NodeIndex root_index, int32_t evaluation_margin)
+{
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+    if (node_index == root_index || node->is_leaf)
+    {
+        return false;
+    }
+    PositionTreeNode*parent = GET_POSITION_TREE_NODE(node->parent_index);
+    if (node->parent_index != root_index &&
+        (node->evaluation == PLAYER_WIN(PLAYER_INDEX_WHITE) ||
+            node->evaluation == PLAYER_WIN(PLAYER_INDEX_BLACK)))
+    {
+        return true;
+    }
+    if (NODE_ACTIVE_PLAYER_INDEX(parent) == PLAYER_INDEX_WHITE)
+    {
+        return parent->evaluation - node->evaluation > evaluation_margin;
+    }
+    return node->evaluation - parent->evaluation > evaluation_margin;
+}
+
+void compact_position_tree(NodeIndex new_root_index, bool collect_garbage,
+    int32_t evaluation_margin)
+{
+    NodeIndex node_count = 0;
+    for (NodeIndex node_index = 0; node_index < g_index_of_first_free_position_tree_node;
+        ++node_index)
+    {
+        PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+        g_tree_position_buckets[get_tree_position_bucket_index(node->position_hash)] =
+            NULL_POSITION_TREE_NODE;
+        if (node_index == new_root_index || (node_index > new_root_index &&
+            g_new_position_tree_node_indices[node->parent_index] != NULL_POSITION_TREE_NODE &&
+            !(collect_garbage &&
+                subtree_is_garbage(node->parent_index, new_root_index, evaluation_margin))))
+        {
+            g_new_position_tree_node_indices[node_index] = node_count;
+            ++node_count;
+        }
+        else
+        {
+            g_new_position_tree_node_indices[node_index] = NULL_POSITION_TREE_NODE;
+        }
+    }
+    for (NodeIndex node_index = 0; node_index < g_index_of_first_free_position_tree_node;
+        ++node_index)
+    {
+        if (!GET_POSITION_TREE_NODE(node_index)->is_canonical)
+        {
+            continue;
+        }
+        PositionTreeNode*previous_transposition = 0;
+        NodeIndex transposition_index = node_index;
+        while (transposition_index != NULL_POSITION_TREE_NODE)
+        {
+            PositionTreeNode*transposition = GET_POSITION_TREE_NODE(transposition_index);
+            NodeIndex next_transposition_index = transposition->next_transposion_index;
+            NodeIndex new_transposition_index =
+                g_new_position_tree_node_indices[transposition_index];
+            if (new_transposition_index != NULL_POSITION_TREE_NODE)
+            {
+                if (previous_transposition)
+                {
+                    previous_transposition->next_transposion_index = new_transposition_index;
+                }
+                transposition->next_transposion_index = NULL_POSITION_TREE_NODE;
+                previous_transposition = transposition;
+            }
+            transposition_index = next_transposition_index;
+        }
+    }
+    for (NodeIndex node_index = new_root_index;
+        node_index < g_index_of_first_free_position_tree_node; ++node_index)
+    {
+        NodeIndex new_node_index = g_new_position_tree_node_indices[node_index];
+        if (new_node_index == NULL_POSITION_TREE_NODE)
+        {
+            continue;
+        }
+        PositionTreeNode*node = GET_POSITION_TREE_NODE(new_node_index);
+        *node = *GET_POSITION_TREE_NODE(node_index);
+        if (new_node_index)
+        {
+            node->parent_index = g_new_position_tree_node_indices[node->parent_index];
+        }
+        else
+        {
+            node->parent_index = NULL_POSITION_TREE_NODE;
+            node->next_move_node_index = NULL_POSITION_TREE_NODE;
+            node->evaluation_has_been_propagated_to_parents = true;
+        }
+        if (node->next_move_node_index != NULL_POSITION_TREE_NODE)
+        {
+            node->next_move_node_index =
+                g_new_position_tree_node_indices[node->next_move_node_index];
+        }
+        if (!node->is_leaf)
+        {
+            NodeIndex first_move_node_index =
+                g_new_position_tree_node_indices[GET_FIRST_MOVE_NODE_INDEX(node)];
+            if (first_move_node_index == NULL_POSITION_TREE_NODE)
+            {
+                node->is_leaf = true;
+                if (node->evaluation != PLAYER_WIN(PLAYER_INDEX_WHITE) &&
+                    node->evaluation != PLAYER_WIN(PLAYER_INDEX_BLACK))
+                {
+                    node->next_move_stage = MOVE_STAGE_CAPTURES;
+                }
+                else
+                {
+                    node->next_move_stage = MOVE_STAGE_DONE;
+                }
+                node->has_skipped_moves = false;
+            }
+            else
+            {
+                SET_FIRST_MOVE_NODE_INDEX(node, first_move_node_index);
+                SET_BEST_MOVE_NODE_INDEX(node,
+                    g_new_position_tree_node_indices[GET_BEST_MOVE_NODE_INDEX(node)]);
+            }
+        }
+    }
+    g_index_of_first_free_position_tree_node = node_count;
+    for (NodeIndex node_index = 0; node_index < node_count; ++node_index)
+    {
+        GET_POSITION_TREE_NODE(node_index)->is_canonical = true;
+    }
+    for (NodeIndex node_index = 0; node_index < node_count; ++node_index)
+    {
+        PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+        if (node->next_transposion_index != NULL_POSITION_TREE_NODE)
+        {
+            GET_POSITION_TREE_NODE(node->next_transposion_index)->is_canonical = false;
+        }
+    }
+    g_first_leaf_index = NULL_POSITION_TREE_NODE;
+    NodeIndex previous_leaf_index = NULL_POSITION_TREE_NODE;
+    for (NodeIndex node_index = 0; node_index < node_count; ++node_index)
+    {
+        PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+        node->is_queued = false;
+        if (node->is_canonical)
+        {
+            NodeIndex*bucket =
+                g_tree_position_buckets + get_tree_position_bucket_index(node->position_hash);
+            node->index_of_next_position_with_same_hash = *bucket;
+            *bucket = node_index;
+        }
+        if (node->is_leaf)
+        {
+            SET_PREVIOUS_LEAF_INDEX(node, previous_leaf_index);
+            SET_NEXT_LEAF_INDEX(node, NULL_POSITION_TREE_NODE);
+            if (previous_leaf_index == NULL_POSITION_TREE_NODE)
+            {
+                g_first_leaf_index = node_index;
+            }
+            else
+            {
+                SET_NEXT_LEAF_INDEX(GET_POSITION_TREE_NODE(previous_leaf_index), node_index);
+            }
+            previous_leaf_index = node_index;
+        }
+    }
+    g_frontier_size = 0;
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+    g_replayed_position_node_index = NULL_POSITION_TREE_NODE;
+#endif
+}
+
+void push_new_frontier_nodes(NodeIndex first_new_node_index)
+{
+    for (NodeIndex node_index = first_new_node_index;
+        node_index < g_index_of_first_free_position_tree_node; ++node_index)
+    {
+        PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+        if (node->is_canonical && node->is_leaf && node->next_move_stage != MOVE_STAGE_DONE)
+        {
+            push_frontier_node(node_index, get_frontier_priority(node_index));
+        }
+    }
+}
+
+void rebuild_frontier(void)
+{
+    g_frontier_size = 0;
+    for (NodeIndex node_index = 0; node_index < g_index_of_first_free_position_tree_node;
+        ++node_index)
+    {
+        PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+        node->is_queued = false;
+        if (node->is_canonical && ((node->is_leaf && node->next_move_stage != MOVE_STAGE_DONE) ||
+            skipped_moves_are_due(node)))
+        {
+            push_frontier_node(node_index, get_frontier_priority(node_index));
+        }
+    }
+}
+
+void reroot_position_tree(Position*position, NodeIndex new_root_index)
+{
+    compact_position_tree(new_root_index, false, 0);
+    position->node_index = 0;
+#ifdef MOVE_DELTA_POSITION_TREE_NODES
+    g_position_tree_root = *position;
+#endif
+}
+
+void init_position_tree_root(Position*position)
+{
+    g_index_of_first_free_position_tree_node = 1;
+    g_first_leaf_index = 0;
+    position->node_index = 0;
+    PositionTreeNode*root = g_position_tree_nodes;
+    root->is_leaf = true;
+    root->next_move_stage = MOVE_STAGE_CAPTURES;
+    root->has_skipped_moves = false;
+    root->is_claimed = false;
+    root->is_queued = false;
+    root->is_canonical = true;
+    root->evaluation_has_been_propagated_to_parents = true;
+    root->parent_index = NULL_POSITION_TREE_NODE;
+    SET_PREVIOUS_LEAF_INDEX(root, NULL_POSITION_TREE_NODE);
+    SET_NEXT_LEAF_INDEX(root, NULL_POSITION_TREE_NODE);
+    root->next_move_node_index = NULL_POSITION_TREE_NODE;
+    compress_position_to_node(position, 0);
+}
+
+bool expand_best_frontier_node(void)
+{
+    while (g_frontier_size)
+    {
+        NodeIndex node_index = pop_frontier_node();
+        PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+        if (skipped_moves_are_due(node))
+        {
+            Position position;
+            decompress_position(&position, node_index);
+            NodeIndex first_new_node_index = g_index_of_first_free_position_tree_node;
+            materialize_skipped_moves(&position);
+            push_new_frontier_nodes(first_new_node_index);
+            return true;
+        }
+        if (node->next_move_stage != MOVE_STAGE_DONE)
+        {
+            Position position;
+            decompress_position(&position, node_index);
+            NodeIndex first_new_node_index = g_index_of_first_free_position_tree_node;
+            get_moves(&position);
+            get_deferred_moves_of_parent(node);
+            push_new_frontier_nodes(first_new_node_index);
+            return true;
+        }
+    }
+    return false;
+}
+
+#define MAX_SEARCH_DEPTH 64
+#define MATE_EVALUATION(ply) (INT16_MAX - (ply))
+#define TIME_CHECK_NODE_INTERVAL 4096
+
+uint64_t g_search_hard_deadline = UINT64_MAX;
+uint32_t g_alpha_beta_node_count;
+NodeIndex g_alpha_beta_best_move_node_index;
+NodeIndex g_alpha_beta_depth_best_move_node_index;
+NodeIndex g_alpha_beta_move_node_index;
+int16_t g_alpha_beta_root_alpha;
+uint8_t g_alpha_beta_depth;
+uint8_t g_max_alpha_beta_depth = MAX_SEARCH_DEPTH;
+bool g_alpha_beta_search_was_stopped;
+
+int16_t get_alpha_beta_evaluation(Position*position, uint8_t depth, uint8_t ply, int16_t alpha,
+    int16_t beta)
+{
+    ++g_alpha_beta_node_count;
+    if (!(g_alpha_beta_node_count % TIME_CHECK_NODE_INTERVAL) &&
+        get_time() >= g_search_hard_deadline)
+    {
+        g_alpha_beta_search_was_stopped = true;
+    }
+    if (g_alpha_beta_search_was_stopped)
+    {
+        return 0;
+    }
+    if (!depth)
+    {
+        return get_quiescence_evaluation(position, alpha, beta,
+            get_king_safety_evaluation(position));
+    }
+    bool move_was_searched = false;
+    for (MoveStage stage = MOVE_STAGE_CAPTURES; stage < MOVE_STAGE_DONE; ++stage)
+    {
+        Move moves[MAX_MOVE_COUNT];
+        uint8_t move_count = get_moves_of_stage(position, stage, moves);
+        for (uint8_t i = 0; i < move_count; ++i)
+        {
+            MoveUndo undo;
+            make_move(position, moves[i], &undo);
+            int16_t evaluation;
+            if (move_was_searched)
+            {
+                evaluation =
+                    -get_alpha_beta_evaluation(position, depth - 1, ply + 1, -alpha - 1, -alpha);
+                if (evaluation > alpha && evaluation < beta)
+                {
+                    evaluation =
+                        -get_alpha_beta_evaluation(position, depth - 1, ply + 1, -beta, -alpha);
+                }
+            }
+            else
+            {
+                evaluation =
+                    -get_alpha_beta_evaluation(position, depth - 1, ply + 1, -beta, -alpha);
+                move_was_searched = true;
+            }
+            unmake_move(position, moves[i], &undo);
+            if (evaluation > alpha)
+            {
+                alpha = evaluation;
+                if (alpha >= beta)
+                {
+                    return alpha;
+                }
+            }
+        }
+    }
+    if (!move_was_searched)
+    {
+        if (king_is_attacked(position, position->active_player_index))
+        {
+            return -MATE_EVALUATION(ply);
+        }
+        return 0;
+    }
+    return alpha;
+}
+
+void init_alpha_beta_search(void)
+{
+    g_alpha_beta_best_move_node_index = GET_FIRST_MOVE_NODE_INDEX(g_position_tree_nodes);
+    g_alpha_beta_move_node_index = NULL_POSITION_TREE_NODE;
+    g_alpha_beta_depth = 1;
+    g_alpha_beta_node_count = 0;
+    g_alpha_beta_search_was_stopped = false;
+}
+
+bool do_alpha_beta_iteration(void)
+{
+    if (g_alpha_beta_move_node_index == NULL_POSITION_TREE_NODE)
+    {
+        g_alpha_beta_move_node_index = g_alpha_beta_best_move_node_index;
+        g_alpha_beta_depth_best_move_node_index = g_alpha_beta_best_move_node_index;
+        g_alpha_beta_root_alpha = -INT16_MAX;
+    }
+    Position position;
+    decompress_position(&position, g_alpha_beta_move_node_index);
+    int16_t evaluation;
+    if (g_alpha_beta_move_node_index == g_alpha_beta_best_move_node_index)
+    {
+        evaluation = -get_alpha_beta_evaluation(&position, g_alpha_beta_depth - 1, 1, -INT16_MAX,
+            -g_alpha_beta_root_alpha);
+    }
+    else
+    {
+        evaluation = -get_alpha_beta_evaluation(&position, g_alpha_beta_depth - 1, 1,
+            -g_alpha_beta_root_alpha - 1, -g_alpha_beta_root_alpha);
+        if (evaluation > g_alpha_beta_root_alpha)
+        {
+            evaluation = -get_alpha_beta_evaluation(&position, g_alpha_beta_depth - 1, 1,
+                -INT16_MAX, -g_alpha_beta_root_alpha);
+        }
+    }
+    if (g_alpha_beta_search_was_stopped)
+    {
+        g_alpha_beta_best_move_node_index = g_alpha_beta_depth_best_move_node_index;
+        return false;
+    }
+    if (evaluation > g_alpha_beta_root_alpha)
+    {
+        g_alpha_beta_root_alpha = evaluation;
+        g_alpha_beta_depth_best_move_node_index = g_alpha_beta_move_node_index;
+    }
+    if (g_alpha_beta_move_node_index == g_alpha_beta_best_move_node_index)
+    {
+        g_alpha_beta_move_node_index = GET_FIRST_MOVE_NODE_INDEX(g_position_tree_nodes);
+    }
+    else
+    {
+        g_alpha_beta_move_node_index =
+            GET_POSITION_TREE_NODE(g_alpha_beta_move_node_index)->next_move_node_index;
+    }
+    if (g_alpha_beta_move_node_index == g_alpha_beta_best_move_node_index)
+    {
+        g_alpha_beta_move_node_index =
+            GET_POSITION_TREE_NODE(g_alpha_beta_move_node_index)->next_move_node_index;
+    }
+    if (g_alpha_beta_move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        return true;
+    }
+    g_alpha_beta_best_move_node_index = g_alpha_beta_depth_best_move_node_index;
+    ++g_alpha_beta_depth;
+    return g_alpha_beta_depth <= g_max_alpha_beta_depth &&
+        g_alpha_beta_root_alpha < MATE_EVALUATION(MAX_SEARCH_DEPTH) &&
+        g_alpha_beta_root_alpha > -MATE_EVALUATION(MAX_SEARCH_DEPTH);
+}
+
+uint8_t g_proof_number_player_index;
+uint32_t g_proof_number_expansion_count;
+
+NodeIndex get_canonical_node_index(NodeIndex node_index)
+{
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+    NodeIndex canonical_index =
+        g_tree_position_buckets[get_tree_position_bucket_index(node->position_hash)];
+    while (true)
+    {
+        PositionTreeNode*canonical_node = GET_POSITION_TREE_NODE(canonical_index);
+        if (canonical_node->position_hash == node->position_hash)
+        {
+            NodeIndex transposition_index = canonical_node->next_transposion_index;
+            while (transposition_index != NULL_POSITION_TREE_NODE)
+            {
+                if (transposition_index == node_index)
+                {
+                    return canonical_index;
+                }
+                transposition_index =
+                    GET_POSITION_TREE_NODE(transposition_index)->next_transposion_index;
+            }
+        }
+        canonical_index = canonical_node->index_of_next_position_with_same_hash;
+    }
+}
+
+ProofNumbers get_proof_numbers(NodeIndex node_index)
+{
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+    if (node->is_leaf)
+    {
+        if (node->next_move_stage != MOVE_STAGE_DONE)
+        {
+            return (ProofNumbers) { 1, 1 };
+        }
+        if (node->evaluation == PLAYER_WIN(g_proof_number_player_index))
+        {
+            return (ProofNumbers) { 0, PROOF_NUMBER_INFINITY };
+        }
+        return (ProofNumbers) { PROOF_NUMBER_INFINITY, 0 };
+    }
+    uint32_t min_number = PROOF_NUMBER_INFINITY;
+    uint32_t number_sum = 0;
+    bool player_is_proving = NODE_ACTIVE_PLAYER_INDEX(node) == g_proof_number_player_index;
+    NodeIndex move_node_index = GET_FIRST_MOVE_NODE_INDEX(node);
+    while (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        ProofNumbers*move_proof_numbers = g_proof_numbers + move_node_index;
+        uint32_t number = move_proof_numbers->disproof_number;
+        uint32_t summed_number = move_proof_numbers->proof_number;
+        if (player_is_proving)
+        {
+            number = move_proof_numbers->proof_number;
+            summed_number = move_proof_numbers->disproof_number;
+        }
+        if (number < min_number)
+        {
+            min_number = number;
+        }
+        if (summed_number == PROOF_NUMBER_INFINITY)
+        {
+            number_sum = PROOF_NUMBER_INFINITY;
+        }
+        else if (number_sum != PROOF_NUMBER_INFINITY)
+        {
+            number_sum += summed_number;
+            if (number_sum < summed_number || number_sum == PROOF_NUMBER_INFINITY)
+            {
+                number_sum = PROOF_NUMBER_UNKNOWN;
+            }
+        }
+        move_node_index = GET_POSITION_TREE_NODE(move_node_index)->next_move_node_index;
+    }
+    if (min_number == PROOF_NUMBER_UNKNOWN)
+    {
+        return (ProofNumbers) { PROOF_NUMBER_UNKNOWN, PROOF_NUMBER_UNKNOWN };
+    }
+    if (player_is_proving)
+    {
+        return (ProofNumbers) { min_number, number_sum };
+    }
+    return (ProofNumbers) { number_sum, min_number };
+}
+
+bool proof_numbers_are_blocked(ProofNumbers*proof_numbers)
+{
+    return proof_numbers->proof_number == PROOF_NUMBER_UNKNOWN &&
+        proof_numbers->disproof_number == PROOF_NUMBER_UNKNOWN;
+}
+
+bool proof_numbers_are_settled(ProofNumbers*proof_numbers)
+{
+    return !proof_numbers->proof_number || !proof_numbers->disproof_number ||
+        proof_numbers_are_blocked(proof_numbers);
+}
+
+void set_proof_numbers(NodeIndex node_index, ProofNumbers proof_numbers)
+{
+    g_proof_numbers[node_index] = proof_numbers;
+    NodeIndex transposition_index = GET_POSITION_TREE_NODE(node_index)->next_transposion_index;
+    while (transposition_index != NULL_POSITION_TREE_NODE)
+    {
+        ProofNumbers*transposition_proof_numbers = g_proof_numbers + transposition_index;
+        if (!proof_numbers_are_settled(transposition_proof_numbers))
+        {
+            *transposition_proof_numbers = proof_numbers;
+        }
+        transposition_index = GET_POSITION_TREE_NODE(transposition_index)->next_transposion_index;
+    }
+}
+
+void update_proof_numbers(NodeIndex node_index)
+{
+    ProofNumbers*proof_numbers = g_proof_numbers + node_index;
+    if (!proof_numbers_are_settled(proof_numbers))
+    {
+        set_proof_numbers(node_index, get_proof_numbers(node_index));
+    }
+}
+
+void update_all_proof_numbers(void)
+{
+    NodeIndex node_index = g_index_of_first_free_position_tree_node;
+    while (node_index)
+    {
+        --node_index;
+        if (GET_POSITION_TREE_NODE(node_index)->is_canonical)
+        {
+            update_proof_numbers(node_index);
+        }
+    }
+    g_proof_number_expansion_count = 0;
+}
+
+void init_proof_number_search(void)
+{
+    g_proof_number_player_index = NODE_ACTIVE_PLAYER_INDEX(g_position_tree_nodes);
+    for (NodeIndex node_index = 0; node_index < g_index_of_first_free_position_tree_node;
+        ++node_index)
+    {
+        g_proof_numbers[node_index] = (ProofNumbers) { 1, 1 };
+    }
+    update_all_proof_numbers();
+}
+
+void unblock_proof_numbers(void)
+{
+    for (NodeIndex node_index = 0; node_index < g_index_of_first_free_position_tree_node;
+        ++node_index)
+    {
+        ProofNumbers*proof_numbers = g_proof_numbers + node_index;
+        if (proof_numbers->proof_number && proof_numbers->disproof_number)
+        {
+            *proof_numbers = (ProofNumbers) { 1, 1 };
+        }
+    }
+    update_all_proof_numbers();
+}
+
+bool expand_most_proving_node(NodeIndex node_index, uint8_t ply)
+{
+    PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+    ProofNumbers*proof_numbers = g_proof_numbers + node_index;
+    if (proof_numbers_are_settled(proof_numbers))
+    {
+        return true;
+    }
+    if (ply >= MAX_SEARCH_DEPTH)
+    {
+        *proof_numbers = (ProofNumbers) { PROOF_NUMBER_UNKNOWN, PROOF_NUMBER_UNKNOWN };
+        return true;
+    }
+    if (!node->is_canonical)
+    {
+        NodeIndex canonical_index = get_canonical_node_index(node_index);
+        if (!expand_most_proving_node(canonical_index, ply))
+        {
+            return false;
+        }
+        if (!proof_numbers_are_settled(proof_numbers))
+        {
+            *proof_numbers = g_proof_numbers[canonical_index];
+        }
+        return true;
+    }
+    if (node->is_leaf)
+    {
+        if (node->next_move_stage != MOVE_STAGE_DONE)
+        {
+            if (g_index_of_first_free_position_tree_node >
+                g_position_tree_node_capacity - MAX_MOVE_COUNT)
+            {
+                return false;
+            }
+            Position position;
+            decompress_position(&position, node_index);
+            NodeIndex first_new_node_index = g_index_of_first_free_position_tree_node;
+            while (node->next_move_stage != MOVE_STAGE_DONE)
+            {
+                Move moves[MAX_MOVE_COUNT];
+                uint8_t next_move_stage = node->next_move_stage;
+                uint8_t move_count = get_staged_moves(&position, &next_move_stage, moves, 0);
+                add_staged_moves(&position, node->next_move_stage, next_move_stage, moves, 0,
+                    move_count);
+            }
+            for (NodeIndex move_node_index = first_new_node_index;
+                move_node_index < g_index_of_first_free_position_tree_node; ++move_node_index)
+            {
+                if (GET_POSITION_TREE_NODE(move_node_index)->is_canonical)
+                {
+                    g_proof_numbers[move_node_index] = (ProofNumbers) { 1, 1 };
+                }
+                else
+                {
+                    g_proof_numbers[move_node_index] =
+                        g_proof_numbers[get_canonical_node_index(move_node_index)];
+                }
+            }
+            ++g_proof_number_expansion_count;
+        }
+        update_proof_numbers(node_index);
+        return true;
+    }
+    update_proof_numbers(node_index);
+    if (proof_numbers_are_settled(proof_numbers))
+    {
+        return true;
+    }
+    bool player_is_proving = NODE_ACTIVE_PLAYER_INDEX(node) == g_proof_number_player_index;
+    NodeIndex most_proving_move_node_index = NULL_POSITION_TREE_NODE;
+    uint32_t min_number = PROOF_NUMBER_INFINITY;
+    NodeIndex move_node_index = GET_FIRST_MOVE_NODE_INDEX(node);
+    while (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        ProofNumbers*move_proof_numbers = g_proof_numbers + move_node_index;
+        uint32_t number = player_is_proving ?
+            move_proof_numbers->proof_number : move_proof_numbers->disproof_number;
+        if (number < min_number || most_proving_move_node_index == NULL_POSITION_TREE_NODE)
+        {
+            min_number = number;
+            most_proving_move_node_index = move_node_index;
+        }
+        move_node_index = GET_POSITION_TREE_NODE(move_node_index)->next_move_node_index;
+    }
+    if (!expand_most_proving_node(most_proving_move_node_index, ply + 1))
+    {
+        return false;
+    }
+    update_proof_numbers(node_index);
+    return true;
+}
+
+bool do_proof_number_iteration(void)
+{
+    if (proof_numbers_are_blocked(g_proof_numbers))
+    {
+        if (!g_proof_number_expansion_count)
+        {
+            return false;
+        }
+        unblock_proof_numbers();
+    }
+    return g_proof_numbers->proof_number && g_proof_numbers->disproof_number &&
+        expand_most_proving_node(0, 0) && g_proof_numbers->proof_number &&
+        g_proof_numbers->disproof_number;
+}
+
+NodeIndex get_proving_move_node_index(void)
+{
+    if (g_position_tree_nodes->is_leaf)
+    {
+        return NULL_POSITION_TREE_NODE;
+    }
+    NodeIndex move_node_index = GET_FIRST_MOVE_NODE_INDEX(g_position_tree_nodes);
+    while (move_node_index != NULL_POSITION_TREE_NODE &&
+        g_proof_numbers[move_node_index].proof_number)
+    {
+        move_node_index = GET_POSITION_TREE_NODE(move_node_index)->next_move_node_index;
+    }
+    return move_node_index;
+}
+
+void init_piece(Position*position, PieceType piece_type, uint8_t piece_index, uint8_t square_index,
+    uint8_t player_index)
+{
+    piece_index += PLAYER_PIECES_INDEX(player_index);
+    Piece*piece = position->pieces + piece_index;
+    piece->square_index = square_index;
+    piece->piece_type = piece_type;
+    position->squares[square_index] = piece_index;
+    position->piece_type_masks[piece_type] |= SQUARE_MASK(square_index);
+    position->player_masks[player_index] |= SQUARE_MASK(square_index);
+}
+
+#define MAX_ENGINE_THREAD_COUNT 64
+#define EXPANSION_JOBS_PER_THREAD 4
+#define ENGINE_QUEUE_LENGTH 16
+#define MIN_GARBAGE_EVALUATION_MARGIN 32
+
+typedef struct ExpansionJob
+{
+    Position position;
+    PositionTreeNode node;
+    Move moves[MAX_MOVE_COUNT];
+    int16_t evaluations[MAX_MOVE_COUNT];
+    NodeIndex first_move_node_index;
+    uint8_t move_count;
+    uint8_t next_move_stage;
+    bool materializes_skipped_moves;
+} ExpansionJob;
+
+typedef struct RootSplitWorker
+{
+    Position root_position;
+    uint64_t root_move_keys[MAX_MOVE_COUNT];
+    int16_t root_move_evaluations[MAX_MOVE_COUNT];
+    Thread thread;
+    uint8_t root_move_count;
+    uint8_t index;
+} RootSplitWorker;
+
+typedef struct EngineClock
+{
+    uint64_t time_left;
+    uint64_t time_increment;
+    uint64_t turn_start_time;
+    uint16_t played_ply_count;
+} EngineClock;
+
+typedef enum EngineCommandType
+{
+    ENGINE_COMMAND_SET_POSITION,
+    ENGINE_COMMAND_PLAY_MOVE,
+    ENGINE_COMMAND_START,
+    ENGINE_COMMAND_PONDER,
+    ENGINE_COMMAND_STOP
+} EngineCommandType;
+
+typedef struct EngineCommand
+{
+    Position position;
+    EngineClock clock;
+    EngineCommandType type;
+    uint8_t move_index;
+} EngineCommand;
+
+typedef enum EngineResultType
+{
+    ENGINE_RESULT_POSITION_READY,
+    ENGINE_RESULT_CHECKMATE,
+    ENGINE_RESULT_STALEMATE,
+    ENGINE_RESULT_BEST_MOVE
+} EngineResultType;
+
+typedef struct EngineResult
+{
+    EngineResultType type;
+    uint8_t move_index;
+} EngineResult;
+
+NodeIndex g_best_move_node_index;
+Position g_engine_position;
+
+EngineCommand g_engine_commands[ENGINE_QUEUE_LENGTH];
+AtomicCounter g_engine_command_count;
+uint32_t g_read_engine_command_count;
+Semaphore g_engine_command_semaphore;
+EngineResult g_engine_results[ENGINE_QUEUE_LENGTH];
+AtomicCounter g_engine_result_count;
+uint32_t g_read_engine_result_count;
+uint32_t g_pending_position_result_count;
+Position g_legal_moves[MAX_MOVE_COUNT];
+uint8_t g_legal_move_count;
+
+ExpansionJob g_expansion_jobs[MAX_ENGINE_THREAD_COUNT * EXPANSION_JOBS_PER_THREAD];
+uint32_t g_expansion_job_count;
+AtomicCounter g_started_expansion_job_count;
+AtomicCounter g_reserved_expansion_node_count;
+NodeIndex g_first_reserved_expansion_node_index;
+Semaphore g_expansion_start_semaphore;
+Semaphore g_expansion_end_semaphore;
+uint32_t g_engine_thread_count;
+RootSplitWorker g_root_split_workers[MAX_ENGINE_THREAD_COUNT];
+uint32_t g_root_split_worker_count;
+AtomicCounter g_finished_root_split_worker_count;
+volatile bool g_stop_root_split_search;
+
+EngineClock g_engine_clock;
+uint64_t g_soft_move_deadline;
+uint64_t g_best_move_change_time;
+bool g_move_deadlines_are_set;
+bool g_engine_is_pondering;
+bool g_engine_has_position_tree;
+
+void stop_root_split_search(void)
+{
+    g_stop_root_split_search = true;
+    for (uint32_t i = 0; i < g_root_split_worker_count; ++i)
+    {
+        join_thread(g_root_split_workers[i].thread);
+    }
+    g_root_split_worker_count = 0;
+}
+
+void send_engine_command(EngineCommand*command)
+{
+    if (command->type == ENGINE_COMMAND_SET_POSITION ||
+        command->type == ENGINE_COMMAND_PLAY_MOVE)
+    {
+        ++g_pending_position_result_count;
+    }
+    g_engine_commands[g_engine_command_count % ENGINE_QUEUE_LENGTH] = *command;
+    ATOMIC_INCREMENT(&g_engine_command_count);
+    signal_semaphore(g_engine_command_semaphore);
+}
+
+void post_engine_result(EngineResultType type, uint8_t move_index)
+{
+    g_engine_results[g_engine_result_count % ENGINE_QUEUE_LENGTH] =
+        (EngineResult) { type, move_index };
+    ATOMIC_INCREMENT(&g_engine_result_count);
+}
+
+void make_position_current(NodeIndex played_move_node_index)
+{
+    g_run_engine = false;
+    g_engine_is_pondering = false;
+    stop_root_split_search();
+    Position*position = &g_engine_position;
+    if (played_move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        reroot_position_tree(position, played_move_node_index);
+        if (g_position_tree_nodes->is_leaf)
+        {
+            g_position_tree_nodes->next_move_stage = MOVE_STAGE_CAPTURES;
+        }
+        if (g_position_tree_nodes->next_move_stage != MOVE_STAGE_DONE &&
+            g_index_of_first_free_position_tree_node >
+            g_position_tree_node_capacity - MAX_MOVE_COUNT)
+        {
+            played_move_node_index = NULL_POSITION_TREE_NODE;
+        }
+    }
+    if (played_move_node_index == NULL_POSITION_TREE_NODE)
+    {
+        clear_position_tree();
+        init_position_tree_root(position);
+    }
+    if (g_position_tree_nodes->has_skipped_moves)
+    {
+        materialize_skipped_moves(position);
+    }
+    while (g_position_tree_nodes->next_move_stage != MOVE_STAGE_DONE)
+    {
+        get_moves(position);
+    }
+    rebuild_frontier();
+    if (!g_position_tree_nodes->is_leaf)
+    {
+        init_alpha_beta_search();
+    }
+    if (g_search_mode == SEARCH_MODE_PROOF_NUMBER)
+    {
+        init_proof_number_search();
+    }
+    g_move_deadlines_are_set = false;
+}
+
+NodeIndex get_best_move_node_index(void)
+{
+    if (g_search_mode == SEARCH_MODE_ALPHA_BETA)
+    {
+        return g_alpha_beta_best_move_node_index;
+    }
+    if (g_search_mode == SEARCH_MODE_PROOF_NUMBER)
+    {
+        NodeIndex proving_move_node_index = get_proving_move_node_index();
+        if (proving_move_node_index != NULL_POSITION_TREE_NODE)
+        {
+            return proving_move_node_index;
+        }
+    }
+    uint8_t player_index = g_engine_position.active_player_index;
+    int64_t best_evaluation = PLAYER_WIN(!player_index);
+    ASSERT(!g_position_tree_nodes->is_leaf);
+    NodeIndex move_node_index = g_position_tree_nodes->first_move_node_index;
+    NodeIndex out = move_node_index;
+    while (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
+        if (player_index == PLAYER_INDEX_WHITE)
+        {
+            if (move_node->evaluation > best_evaluation)
+            {
+                best_evaluation = move_node->evaluation;
+                out = move_node_index;
+            }
+        }
+        else if (move_node->evaluation < best_evaluation)
+        {
+            best_evaluation = move_node->evaluation;
+            out = move_node_index;
+        }
+        move_node_index = move_node->next_move_node_index;
+    }
+    return out;
+}
+
+void set_move_deadlines(void)
+{
+    uint64_t time_left = g_engine_clock.time_left;
+    uint64_t usable_time = time_left - time_left / 16;
+    uint64_t moves_to_go = 20;
+    if (g_engine_clock.played_ply_count < 60)
+    {
+        moves_to_go = 50 - g_engine_clock.played_ply_count / 2;
+    }
+    uint64_t soft_time = usable_time / moves_to_go + 3 * g_engine_clock.time_increment / 4;
+    uint64_t hard_time = 4 * soft_time;
+    if (hard_time > usable_time / 4 + g_engine_clock.time_increment / 2)
+    {
+        hard_time = usable_time / 4 + g_engine_clock.time_increment / 2;
+    }
+    if (hard_time > usable_time)
+    {
+        hard_time = usable_time;
+    }
+    if (soft_time > hard_time)
+    {
+        soft_time = hard_time;
+    }
+    g_soft_move_deadline = g_engine_clock.turn_start_time + soft_time;
+    g_search_hard_deadline = g_engine_clock.turn_start_time + hard_time;
+    g_best_move_change_time = g_engine_clock.turn_start_time;
+    g_best_move_node_index = NULL_POSITION_TREE_NODE;
+    g_move_deadlines_are_set = true;
+}
+
+bool move_time_is_up(void)
+{
+    uint64_t time = get_time();
+    if (time >= g_search_hard_deadline)
+    {
+        return true;
+    }
+    NodeIndex best_move_node_index = get_best_move_node_index();
+    if (best_move_node_index != g_best_move_node_index)
+    {
+        g_best_move_node_index = best_move_node_index;
+        g_best_move_change_time = time;
+    }
+    uint64_t soft_time = g_soft_move_deadline - g_engine_clock.turn_start_time;
+    uint64_t stable_time = time - g_best_move_change_time;
+    if (time >= g_soft_move_deadline)
+    {
+        return stable_time >= soft_time / 8;
+    }
+    return time - g_engine_clock.turn_start_time >= soft_time / 2 &&
+        stable_time >= soft_time / 2;
+}
+
+bool collect_position_tree_garbage(NodeIndex*best_move_node_index)
+{
+    int32_t evaluation_margin = INT16_MAX;
+    while (true)
+    {
+        compact_position_tree(0, true, evaluation_margin);
+        if (best_move_node_index && *best_move_node_index != NULL_POSITION_TREE_NODE)
+        {
+            *best_move_node_index = g_new_position_tree_node_indices[*best_move_node_index];
+        }
+        if (g_index_of_first_free_position_tree_node <=
+            g_position_tree_node_capacity - g_position_tree_node_capacity / 4)
+        {
+            break;
+        }
+        if (evaluation_margin / 2 < MIN_GARBAGE_EVALUATION_MARGIN)
+        {
+            break;
+        }
+        evaluation_margin /= 2;
+    }
+    rebuild_frontier();
+    return g_index_of_first_free_position_tree_node <=
+        g_position_tree_node_capacity - 2 * MAX_MOVE_COUNT;
+}
+
+void run_expansion_jobs(void)
+{
+    while (true)
+    {
+        uint32_t job_index = ATOMIC_INCREMENT(&g_started_expansion_job_count) - 1;
+        if (job_index >= g_expansion_job_count)
+        {
+            return;
+        }
+        ExpansionJob*job = g_expansion_jobs + job_index;
+        if (job->materializes_skipped_moves)
+        {
+            job->move_count = get_skipped_moves(&job->position, job->next_move_stage, job->moves,
+                job->evaluations);
+        }
+        else
+        {
+            job->move_count = get_staged_moves(&job->position, &job->next_move_stage, job->moves,
+                job->evaluations);
+            job->move_count = skip_moves_outside_margin(&job->node, &job->position, job->moves,
+                job->evaluations, job->move_count);
+            job->first_move_node_index = g_first_reserved_expansion_node_index +
+                ATOMIC_ADD(&g_reserved_expansion_node_count, job->move_count) - job->move_count;
+        }
+    }
+}
+
+THREAD_PROCEDURE(run_expansion_worker, parameter)
+{
+    while (true)
+    {
+        wait_semaphore(g_expansion_start_semaphore);
+        run_expansion_jobs();
+        signal_semaphore(g_expansion_end_semaphore);
+    }
+    return 0;
+}
+
+void init_engine_threads(void)
+{
+    if (!g_engine_thread_count)
+    {
+        g_engine_thread_count = get_processor_count();
+    }
+    if (!g_engine_thread_count)
+    {
+        g_engine_thread_count = 1;
+    }
+    else if (g_engine_thread_count > MAX_ENGINE_THREAD_COUNT)
+    {
+        g_engine_thread_count = MAX_ENGINE_THREAD_COUNT;
+    }
+    g_expansion_start_semaphore = create_semaphore();
+    g_expansion_end_semaphore = create_semaphore();
+    for (uint32_t i = 1; i < g_engine_thread_count; ++i)
+    {
+        create_thread(run_expansion_worker, 0);
+    }
+}
+
+THREAD_PROCEDURE(run_root_split_worker, parameter)
+{
+    RootSplitWorker*worker = parameter;
+    worker->root_move_count = 0;
+    if (!init_position_tree(get_position_tree_node_capacity(
+        g_position_tree_byte_count / g_root_split_worker_count)))
+    {
+        ATOMIC_INCREMENT(&g_finished_root_split_worker_count);
+        return 0;
+    }
+    Position*position = &worker->root_position;
+    init_position_tree_root(position);
+    Move moves[MAX_MOVE_COUNT];
+    int16_t evaluations[MAX_MOVE_COUNT];
+    uint8_t move_count = 0;
+    uint8_t next_move_stage = MOVE_STAGE_CAPTURES;
+    while (next_move_stage != MOVE_STAGE_DONE)
+    {
+        move_count += get_staged_moves(position, &next_move_stage, moves + move_count,
+            evaluations + move_count);
+    }
+    uint8_t worker_move_count = 0;
+    for (uint8_t i = worker->index; i < move_count; i += g_root_split_worker_count)
+    {
+        moves[worker_move_count] = moves[i];
+        evaluations[worker_move_count] = evaluations[i];
+        ++worker_move_count;
+    }
+    add_staged_moves(position, MOVE_STAGE_CAPTURES, MOVE_STAGE_DONE, moves, evaluations,
+        worker_move_count);
+    rebuild_frontier();
+    while (!g_stop_root_split_search)
+    {
+        if (g_index_of_first_free_position_tree_node >
+            g_position_tree_node_capacity - g_position_tree_node_capacity / 16 &&
+            !collect_position_tree_garbage(0))
+        {
+            break;
+        }
+        if (!expand_best_frontier_node())
+        {
+            break;
+        }
+    }
+    NodeIndex move_node_index = g_position_tree_nodes->is_leaf ?
+        NULL_POSITION_TREE_NODE : GET_FIRST_MOVE_NODE_INDEX(g_position_tree_nodes);
+    while (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        Position move_position;
+        decompress_position(&move_position, move_node_index);
+        PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
+        worker->root_move_keys[worker->root_move_count] = move_position.zobrist_key;
+        worker->root_move_evaluations[worker->root_move_count] = move_node->evaluation;
+        ++worker->root_move_count;
+        move_node_index = move_node->next_move_node_index;
+    }
+    release_position_tree();
+    ATOMIC_INCREMENT(&g_finished_root_split_worker_count);
+    return 0;
+}
+
+void start_root_split_search(void)
+{
+    uint32_t root_move_count = 0;
+    NodeIndex move_node_index = GET_FIRST_MOVE_NODE_INDEX(g_position_tree_nodes);
+    while (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        ++root_move_count;
+        move_node_index = GET_POSITION_TREE_NODE(move_node_index)->next_move_node_index;
+    }
+    g_root_split_worker_count = g_engine_thread_count;
+    if (g_root_split_worker_count > root_move_count)
+    {
+        g_root_split_worker_count = root_move_count;
+    }
+    g_finished_root_split_worker_count = 0;
+    g_stop_root_split_search = false;
+    for (uint32_t i = 0; i < g_root_split_worker_count; ++i)
+    {
+        RootSplitWorker*worker = g_root_split_workers + i;
+        worker->root_position = g_engine_position;
+        worker->index = i;
+        worker->thread = create_thread(run_root_split_worker, worker);
+    }
+}
+
+void finish_root_split_search(void)
+{
+    uint32_t worker_count = g_root_split_worker_count;
+    stop_root_split_search();
+    NodeIndex move_node_index = GET_FIRST_MOVE_NODE_INDEX(g_position_tree_nodes);
+    while (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        Position move_position;
+        decompress_position(&move_position, move_node_index);
+        PositionTreeNode*move_node = GET_POSITION_TREE_NODE(move_node_index);
+        for (uint32_t i = 0; i < worker_count; ++i)
+        {
+            RootSplitWorker*worker = g_root_split_workers + i;
+            for (uint8_t j = 0; j < worker->root_move_count; ++j)
+            {
+                if (worker->root_move_keys[j] == move_position.zobrist_key)
+                {
+                    move_node->evaluation = worker->root_move_evaluations[j];
+                }
+            }
+        }
+        move_node_index = move_node->next_move_node_index;
+    }
+    g_position_tree_nodes->evaluation = update_best_move(g_position_tree_nodes);
+}
+
+void expand_frontier_nodes(void)
+{
+    uint32_t max_job_count = g_engine_thread_count * EXPANSION_JOBS_PER_THREAD;
+    uint32_t free_node_count =
+        g_position_tree_node_capacity - g_index_of_first_free_position_tree_node;
+    if (max_job_count > free_node_count / (2 * MAX_MOVE_COUNT))
+    {
+        max_job_count = free_node_count / (2 * MAX_MOVE_COUNT);
+    }
+    while (g_committed_position_tree_node_count - g_index_of_first_free_position_tree_node <
+        max_job_count * MAX_MOVE_COUNT && commit_position_tree_nodes())
+    {
+    }
+    uint32_t reservable_node_count =
+        g_committed_position_tree_node_count - g_index_of_first_free_position_tree_node;
+    if (max_job_count > reservable_node_count / MAX_MOVE_COUNT)
+    {
+        max_job_count = reservable_node_count / MAX_MOVE_COUNT;
+    }
+    g_expansion_job_count = 0;
+    while (g_expansion_job_count < max_job_count && g_frontier_size)
+    {
+        NodeIndex node_index = pop_frontier_node();
+        PositionTreeNode*node = GET_POSITION_TREE_NODE(node_index);
+        bool materializes_skipped_moves = skipped_moves_are_due(node);
+        if (!node->is_claimed &&
+            (materializes_skipped_moves || node->next_move_stage != MOVE_STAGE_DONE))
+        {
+            node->is_claimed = true;
+            ExpansionJob*job = g_expansion_jobs + g_expansion_job_count;
+            decompress_position(&job->position, node_index);
+            job->node = *node;
+            job->next_move_stage = node->next_move_stage;
+            job->materializes_skipped_moves = materializes_skipped_moves;
+            ++g_expansion_job_count;
+        }
+    }
+    uint32_t worker_count = g_engine_thread_count - 1;
+    if (worker_count >= g_expansion_job_count)
+    {
+        worker_count = g_expansion_job_count ? g_expansion_job_count - 1 : 0;
+    }
+    NodeIndex first_new_node_index = g_index_of_first_free_position_tree_node;
+    g_first_reserved_expansion_node_index = first_new_node_index;
+    g_reserved_expansion_node_count = 0;
+    g_started_expansion_job_count = 0;
+    for (uint32_t i = 0; i < worker_count; ++i)
+    {
+        signal_semaphore(g_expansion_start_semaphore);
+    }
+    run_expansion_jobs();
+    for (uint32_t i = 0; i < worker_count; ++i)
+    {
+        wait_semaphore(g_expansion_end_semaphore);
+    }
+    g_index_of_first_free_position_tree_node += g_reserved_expansion_node_count;
+    for (uint32_t i = 0; i < g_expansion_job_count; ++i)
+    {
+        ExpansionJob*job = g_expansion_jobs + i;
+        PositionTreeNode*node = GET_POSITION_TREE_NODE(job->position.node_index);
+        node->is_claimed = false;
+        if (job->materializes_skipped_moves)
+        {
+            add_skipped_moves(&job->position, job->next_move_stage, job->moves,
+                job->evaluations, job->move_count);
+        }
+        else
+        {
+            node->has_skipped_moves = job->node.has_skipped_moves;
+            node->best_skipped_move_evaluation = job->node.best_skipped_move_evaluation;
+            add_reserved_moves(&job->position, job->next_move_stage, job->moves,
+                job->evaluations, job->first_move_node_index, job->move_count);
+        }
+    }
+    for (uint32_t i = 0; i < g_expansion_job_count; ++i)
+    {
+        ExpansionJob*job = g_expansion_jobs + i;
+        if (!job->materializes_skipped_moves)
+        {
+            get_deferred_moves_of_parent(GET_POSITION_TREE_NODE(job->position.node_index));
+        }
+    }
+    push_new_frontier_nodes(first_new_node_index);
+}
+
+uint8_t get_root_move_index(NodeIndex root_move_node_index)
+{
+    uint8_t out = 0;
+    NodeIndex move_node_index = GET_FIRST_MOVE_NODE_INDEX(g_position_tree_nodes);
+    while (move_node_index != root_move_node_index)
+    {
+        ++out;
+        move_node_index = GET_POSITION_TREE_NODE(move_node_index)->next_move_node_index;
+    }
+    return out;
+}
+
+NodeIndex get_root_move_node_index(uint8_t root_move_index)
+{
+    NodeIndex out = GET_FIRST_MOVE_NODE_INDEX(g_position_tree_nodes);
+    while (root_move_index)
+    {
+        --root_move_index;
+        out = GET_POSITION_TREE_NODE(out)->next_move_node_index;
+    }
+    return out;
+}
+
+void do_engine_iteration(void)
+{
+    if (!g_move_deadlines_are_set && !g_engine_is_pondering)
+    {
+        set_move_deadlines();
+    }
+    if (g_search_mode == SEARCH_MODE_ALPHA_BETA)
+    {
+        g_run_engine = do_alpha_beta_iteration() && !move_time_is_up();
+    }
+    else if (g_search_mode == SEARCH_MODE_PROOF_NUMBER)
+    {
+        g_run_engine = do_proof_number_iteration() && !move_time_is_up();
+    }
+    else if (g_search_mode == SEARCH_MODE_ROOT_SPLIT)
+    {
+        if (!g_root_split_worker_count)
+        {
+            start_root_split_search();
+        }
+        else if (ATOMIC_LOAD(&g_finished_root_split_worker_count) == g_root_split_worker_count ||
+            get_time() >= g_soft_move_deadline)
+        {
+            g_run_engine = false;
+        }
+        else
+        {
+            sleep_milliseconds(1);
+        }
+    }
+    else if (g_index_of_first_free_position_tree_node >
+        g_position_tree_node_capacity - g_position_tree_node_capacity / 16 &&
+        !collect_position_tree_garbage(&g_best_move_node_index))
+    {
+        g_run_engine = false;
+    }
+    else
+    {
+        expand_frontier_nodes();
+        if (!g_expansion_job_count || (!g_engine_is_pondering && move_time_is_up()))
+        {
+            g_run_engine = false;
+        }
+    }
+    if (!g_run_engine && !g_engine_is_pondering)
+    {
+        if (g_root_split_worker_count)
+        {
+            finish_root_split_search();
+        }
+        post_engine_result(ENGINE_RESULT_BEST_MOVE,
+            get_root_move_index(get_best_move_node_index()));
+    }
+}
+
+void post_position_result(void)
+{
+    g_legal_move_count = 0;
+    if (g_position_tree_nodes->is_leaf)
+    {
+        if (g_position_tree_nodes->evaluation ==
+            PLAYER_WIN(!g_engine_position.active_player_index))
+        {
+            post_engine_result(ENGINE_RESULT_CHECKMATE, 0);
+        }
+        else
+        {
+            post_engine_result(ENGINE_RESULT_STALEMATE, 0);
+        }
+        return;
+    }
+    NodeIndex move_node_index = GET_FIRST_MOVE_NODE_INDEX(g_position_tree_nodes);
+    while (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        decompress_position(g_legal_moves + g_legal_move_count, move_node_index);
+        ++g_legal_move_count;
+        move_node_index = GET_POSITION_TREE_NODE(move_node_index)->next_move_node_index;
+    }
+    post_engine_result(ENGINE_RESULT_POSITION_READY, 0);
+}
+
+void run_engine_command(EngineCommand*command)
+{
+    switch (command->type)
+    {
+    case ENGINE_COMMAND_SET_POSITION:
+    {
+        g_engine_position = command->position;
+        make_position_current(NULL_POSITION_TREE_NODE);
+        post_position_result();
+        break;
+    }
+    case ENGINE_COMMAND_PLAY_MOVE:
+    {
+        EXPORT_POSITION_TREE();
+        NodeIndex move_node_index = get_root_move_node_index(command->move_index);
+        decompress_position(&g_engine_position, move_node_index);
+        make_position_current(move_node_index);
+        post_position_result();
+        break;
+    }
+    case ENGINE_COMMAND_START:
+    {
+        g_engine_clock = command->clock;
+        g_run_engine = true;
+        g_engine_is_pondering = false;
+        g_move_deadlines_are_set = false;
+        break;
+    }
+    case ENGINE_COMMAND_PONDER:
+    {
+        g_run_engine = g_search_mode == SEARCH_MODE_TREE;
+        g_engine_is_pondering = true;
+        break;
+    }
+    case ENGINE_COMMAND_STOP:
+    {
+        g_run_engine = false;
+        g_engine_is_pondering = false;
+        stop_root_split_search();
+    }
+    }
+}
+
+THREAD_PROCEDURE(run_engine, parameter)
+{
+    g_engine_has_position_tree =
+        init_position_tree(get_position_tree_node_capacity(g_position_tree_byte_count));
+    signal_semaphore(parameter);
+    if (!g_engine_has_position_tree)
+    {
+        return 0;
+    }
+    init_engine_threads();
+    while (true)
+    {
+        if (!g_run_engine || g_read_engine_command_count != ATOMIC_LOAD(&g_engine_command_count))
+        {
+            wait_semaphore(g_engine_command_semaphore);
+            run_engine_command(
+                g_engine_commands + g_read_engine_command_count % ENGINE_QUEUE_LENGTH);
+            ++g_read_engine_command_count;
+        }
+        else
+        {
+            do_engine_iteration();
+        }
+    }
+    return 0;
+}
+
+bool poll_engine_result(EngineResult*out)
+{
+    while (g_read_engine_result_count != ATOMIC_LOAD(&g_engine_result_count))
+    {
+        *out = g_engine_results[g_read_engine_result_count % ENGINE_QUEUE_LENGTH];
+        ++g_read_engine_result_count;
+        if (out->type != ENGINE_RESULT_BEST_MOVE)
+        {
+            --g_pending_position_result_count;
+        }
+        if (!g_pending_position_result_count)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool init_engine(void)
+{
+    g_engine_command_semaphore = create_semaphore();
+    Semaphore engine_start_semaphore = create_semaphore();
+    create_thread(run_engine, engine_start_semaphore);
+    wait_semaphore(engine_start_semaphore);
+    return g_engine_has_position_tree;
+}
@@ -0,0 +1,173 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SQUARE_INDEX(rank, file) (8 * (rank) + (file))
+#define SQUARE_MASK(square_index) ((uint64_t)1 << (square_index))
+
+int8_t g_ray_deltas[8][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 }, { 1, 1 }, { -1, 1 },
+    { -1, -1 }, { 1, -1 } };
+int8_t g_knight_deltas[8][2] = { { 2, 1 }, { 1, 2 }, { -1, 2 }, { -2, 1 }, { -2, -1 },
+    { -1, -2 }, { 1, -2 }, { 2, -1 } };
+
+uint64_t get_ray_mask(uint8_t square_index, uint8_t direction)
+{
+    uint64_t out = 0;
+    uint8_t rank = square_index / 8;
+    uint8_t file = square_index % 8;
+    while (true)
+    {
+        rank += g_ray_deltas[direction][0];
+        file += g_ray_deltas[direction][1];
+        if (rank > 7 || file > 7)
+        {
+            return out;
+        }
+        out |= SQUARE_MASK(SQUARE_INDEX(rank, file));
+    }
+}
+
+uint64_t get_step_mask(uint8_t square_index, int8_t deltas[8][2])
+{
+    uint64_t out = 0;
+    for (uint8_t i = 0; i < 8; ++i)
+    {
+        uint8_t rank = square_index / 8 + deltas[i][0];
+        uint8_t file = square_index % 8 + deltas[i][1];
+        if (rank < 8 && file < 8)
+        {
+            out |= SQUARE_MASK(SQUARE_INDEX(rank, file));
+        }
+    }
+    return out;
+}
+
+uint64_t get_pawn_attack_mask(uint8_t player_index, uint8_t square_index)
+{
+    uint64_t out = 0;
+    uint8_t rank = square_index / 8 + (player_index ? 1 : -1);
+    uint8_t file = square_index % 8;
+    if (rank < 8)
+    {
+        if (file)
+        {
+            out |= SQUARE_MASK(SQUARE_INDEX(rank, file - 1));
+        }
+        if (file < 7)
+        {
+            out |= SQUARE_MASK(SQUARE_INDEX(rank, file + 1));
+        }
+    }
+    return out;
+}
+
+uint64_t get_squares_between_mask(uint8_t square_index, uint8_t other_square_index)
+{
+    for (uint8_t direction = 0; direction < 8; ++direction)
+    {
+        uint64_t ray_mask = get_ray_mask(square_index, direction);
+        if (ray_mask & SQUARE_MASK(other_square_index))
+        {
+            return ray_mask & ~get_ray_mask(other_square_index, direction) &
+                ~SQUARE_MASK(other_square_index);
+        }
+    }
+    return 0;
+}
+
+uint8_t get_king_distance(uint8_t square_index, uint8_t other_square_index)
+{
+    int8_t rank_delta = square_index / 8 - other_square_index / 8;
+    int8_t file_delta = square_index % 8 - other_square_index % 8;
+    if (rank_delta < 0)
+    {
+        rank_delta = -rank_delta;
+    }
+    if (file_delta < 0)
+    {
+        file_delta = -file_delta;
+    }
+    if (rank_delta > file_delta)
+    {
+        return rank_delta;
+    }
+    return file_delta;
+}
+
+void print_masks(uint64_t masks[64], char*indentation)
+{
+    for (uint8_t square_index = 0; square_index < 64; square_index += 4)
+    {
+        printf("%s0x%016llx, 0x%016llx, 0x%016llx, 0x%016llx,\n", indentation,
+            (unsigned long long)masks[square_index], (unsigned long long)masks[square_index + 1],
+            (unsigned long long)masks[square_index + 2],
+            (unsigned long long)masks[square_index + 3]);
+    }
+}
+
+int main(void)
+{
+    uint64_t masks[64];
+    printf("uint64_t g_knight_attack_masks[64] =\n{\n");
+    for (uint8_t square_index = 0; square_index < 64; ++square_index)
+    {
+        masks[square_index] = get_step_mask(square_index, g_knight_deltas);
+    }
+    print_masks(masks, "    ");
+    printf("};\n\nuint64_t g_king_attack_masks[64] =\n{\n");
+    for (uint8_t square_index = 0; square_index < 64; ++square_index)
+    {
+        masks[square_index] = get_step_mask(square_index, g_ray_deltas);
+    }
+    print_masks(masks, "    ");
+    printf("};\n\nuint64_t g_pawn_attack_masks[2][64] =\n{\n");
+    for (uint8_t player_index = 0; player_index < 2; ++player_index)
+    {
+        for (uint8_t square_index = 0; square_index < 64; ++square_index)
+        {
+            masks[square_index] = get_pawn_attack_mask(player_index, square_index);
+        }
+        printf("    {\n");
+        print_masks(masks, "        ");
+        printf("    },\n");
+    }
+    printf("};\n\nuint64_t g_ray_masks[8][64] =\n{\n");
+    for (uint8_t direction = 0; direction < 8; ++direction)
+    {
+        for (uint8_t square_index = 0; square_index < 64; ++square_index)
+        {
+            masks[square_index] = get_ray_mask(square_index, direction);
+        }
+        printf("    {\n");
+        print_masks(masks, "        ");
+        printf("    },\n");
+    }
+    printf("};\n\nuint64_t g_squares_between_masks[64][64] =\n{\n");
+    for (uint8_t square_index = 0; square_index < 64; ++square_index)
+    {
+        for (uint8_t other_square_index = 0; other_square_index < 64; ++other_square_index)
+        {
+            masks[other_square_index] = get_squares_between_mask(square_index, other_square_index);
+        }
+        printf("    {\n");
+        print_masks(masks, "        ");
+        printf("    },\n");
+    }
+    printf("};\n\nuint8_t g_king_distances[64][64] =\n{\n");
+    for (uint8_t square_index = 0; square_index < 64; ++square_index)
+    {
+        printf("    {\n");
+        for (uint8_t other_square_index = 0; other_square_index < 64; other_square_index += 16)
+        {
+            printf("       ");
+            for (uint8_t i = 0; i < 16; ++i)
+            {
+                printf(" %u,", get_king_distance(square_index, other_square_index + i));
+            }
+            printf("\n");
+        }
+        printf("    },\n");
+    }
+    printf("};\n");
+    return 0;
+}
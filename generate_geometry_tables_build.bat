@@ -0,0 +1 @@
+cl generate_geometry_tables.c /O2 && generate_geometry_tables.exe > geometry_tables.c
\ No newline at end of file
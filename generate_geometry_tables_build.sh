@@ -0,0 +1 @@
+gcc generate_geometry_tables.c -O2 -o generate_geometry_tables && ./generate_geometry_tables > geometry_tables.c
\ No newline at end of file
@@ -0,0 +1,502 @@
+#define POSITION_TREE_STORAGE THREAD_LOCAL
+#include "engine.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_THREAD_COUNT 64
+
+typedef struct PerftThread
+{
+    Position*root_moves;
+    uint64_t*root_move_leaf_counts;
+    uint8_t root_move_count;
+    uint8_t first_root_move_index;
+    uint8_t thread_count;
+    uint8_t depth;
+    bool bulk_count;
+} PerftThread;
+
+char*g_start_position_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+bool load_fen(Position*position, char*fen)
+{
+    memset(position, 0, sizeof(*position));
+    memset(position->squares, NULL_PIECE, sizeof(position->squares));
+    for (uint8_t piece_index = 0; piece_index < 32; ++piece_index)
+    {
+        position->pieces[piece_index].square_index = NULL_SQUARE;
+    }
+    uint8_t next_piece_index[2] = { 1, 1 };
+    bool king_was_found[2] = { false, false };
+    uint8_t rank = 0;
+    uint8_t file = 0;
+    for (; *fen != ' '; ++fen)
+    {
+        if (!*fen)
+        {
+            return false;
+        }
+        if (*fen == '/')
+        {
+            if (file != FILE_COUNT || rank == RANK_COUNT - 1)
+            {
+                return false;
+            }
+            ++rank;
+            file = 0;
+            continue;
+        }
+        if (*fen >= '1' && *fen <= '8')
+        {
+            file += *fen - '0';
+            if (file > FILE_COUNT)
+            {
+                return false;
+            }
+            continue;
+        }
+        if (file == FILE_COUNT)
+        {
+            return false;
+        }
+        uint8_t player_index = *fen >= 'a';
+        PieceType piece_type;
+        switch (*fen | 0x20)
+        {
+        case 'b':
+        {
+            piece_type = PIECE_BISHOP;
+            break;
+        }
+        case 'k':
+        {
+            piece_type = PIECE_KING;
+            break;
+        }
+        case 'n':
+        {
+            piece_type = PIECE_KNIGHT;
+            break;
+        }
+        case 'p':
+        {
+            piece_type = PIECE_PAWN;
+            break;
+        }
+        case 'q':
+        {
+            piece_type = PIECE_QUEEN;
+            break;
+        }
+        case 'r':
+        {
+            piece_type = PIECE_ROOK;
+            break;
+        }
+        default:
+        {
+            return false;
+        }
+        }
+        if (piece_type == PIECE_KING)
+        {
+            if (king_was_found[player_index])
+            {
+                return false;
+            }
+            king_was_found[player_index] = true;
+            init_piece(position, piece_type, 0, SQUARE_INDEX(rank, file), player_index);
+        }
+        else
+        {
+            if (next_piece_index[player_index] == 16)
+            {
+                return false;
+            }
+            init_piece(position, piece_type, next_piece_index[player_index],
+                SQUARE_INDEX(rank, file), player_index);
+            ++next_piece_index[player_index];
+        }
+        ++file;
+    }
+    if (rank != RANK_COUNT - 1 || file != FILE_COUNT || !king_was_found[PLAYER_INDEX_WHITE] ||
+        !king_was_found[PLAYER_INDEX_BLACK])
+    {
+        return false;
+    }
+    ++fen;
+    switch (*fen)
+    {
+    case 'w':
+    {
+        position->active_player_index = PLAYER_INDEX_WHITE;
+        break;
+    }
+    case 'b':
+    {
+        position->active_player_index = PLAYER_INDEX_BLACK;
+        break;
+    }
+    default:
+    {
+        return false;
+    }
+    }
+    ++fen;
+    if (*fen != ' ')
+    {
+        return false;
+    }
+    ++fen;
+    position->castling_rights_lost = 0b1111;
+    for (; *fen && *fen != ' '; ++fen)
+    {
+        switch (*fen)
+        {
+        case 'K':
+        {
+            position->castling_rights_lost &= ~(0b10 << (PLAYER_INDEX_WHITE << 1));
+            break;
+        }
+        case 'Q':
+        {
+            position->castling_rights_lost &= ~(1 << (PLAYER_INDEX_WHITE << 1));
+            break;
+        }
+        case 'k':
+        {
+            position->castling_rights_lost &= ~(0b10 << (PLAYER_INDEX_BLACK << 1));
+            break;
+        }
+        case 'q':
+        {
+            position->castling_rights_lost &= ~(1 << (PLAYER_INDEX_BLACK << 1));
+            break;
+        }
+        case '-':
+        {
+            break;
+        }
+        default:
+        {
+            return false;
+        }
+        }
+    }
+    position->en_passant_file = FILE_COUNT;
+    if (*fen == ' ' && fen[1] >= 'a' && fen[1] <= 'h')
+    {
+        position->en_passant_file = fen[1] - 'a';
+    }
+    init_square_control_counts(position);
+    init_zobrist_key(position);
+    return true;
+}
+
+uint8_t expand_position(Position*position)
+{
+    init_position_tree_root(position);
+    while (g_position_tree_nodes->next_move_stage != MOVE_STAGE_DONE)
+    {
+        Move moves[MAX_MOVE_COUNT];
+        uint8_t next_move_stage = g_position_tree_nodes->next_move_stage;
+        uint8_t move_count = get_staged_moves(position, &next_move_stage, moves, 0);
+        add_staged_moves(position, g_position_tree_nodes->next_move_stage, next_move_stage,
+            moves, 0, move_count);
+    }
+    return g_index_of_first_free_position_tree_node - 1;
+}
+
+uint8_t get_children(Position*position, Position*children)
+{
+    uint8_t child_count = 0;
+    if (expand_position(position))
+    {
+        NodeIndex move_node_index = GET_FIRST_MOVE_NODE_INDEX(g_position_tree_nodes);
+        while (move_node_index != NULL_POSITION_TREE_NODE)
+        {
+            decompress_position(children + child_count, move_node_index);
+            ++child_count;
+            move_node_index = GET_POSITION_TREE_NODE(move_node_index)->next_move_node_index;
+        }
+    }
+    clear_position_tree();
+    return child_count;
+}
+
+uint64_t perft(Position*position, Position*children, uint8_t depth, bool bulk_count)
+{
+    if (!depth)
+    {
+        return 1;
+    }
+    if (depth == 1 && bulk_count)
+    {
+        uint8_t move_count = expand_position(position);
+        clear_position_tree();
+        return move_count;
+    }
+    uint8_t child_count = get_children(position, children);
+    uint64_t out = 0;
+    for (uint8_t i = 0; i < child_count; ++i)
+    {
+        out += perft(children + i, children + MAX_MOVE_COUNT, depth - 1, bulk_count);
+    }
+    return out;
+}
+
+THREAD_PROCEDURE(count_root_move_leaves, parameter)
+{
+    PerftThread*thread = parameter;
+    if (!init_position_tree(2 * MAX_MOVE_COUNT))
+    {
+        printf("out of memory\n");
+        exit(1);
+    }
+    Position*children = ALLOCATE(sizeof(Position) * MAX_MOVE_COUNT * thread->depth);
+    for (uint8_t i = thread->first_root_move_index; i < thread->root_move_count;
+        i += thread->thread_count)
+    {
+        thread->root_move_leaf_counts[i] = perft(thread->root_moves + i, children,
+            thread->depth - 1, thread->bulk_count);
+    }
+    FREE_MEMORY(children);
+    release_position_tree();
+    return 0;
+}
+
+void get_move_string(Position*position, Position*move, char*out)
+{
+    uint8_t player_index = position->active_player_index;
+    uint64_t origin_mask =
+        position->player_masks[player_index] & ~move->player_masks[player_index];
+    uint64_t destination_mask =
+        move->player_masks[player_index] & ~position->player_masks[player_index];
+    uint32_t origin_square_index;
+    uint32_t destination_square_index;
+    if (origin_mask & (origin_mask - 1))
+    {
+        origin_square_index = position->pieces[PLAYER_PIECES_INDEX(player_index)].square_index;
+        destination_square_index = move->pieces[PLAYER_PIECES_INDEX(player_index)].square_index;
+    }
+    else
+    {
+        BIT_SCAN_FORWARD_64(&origin_square_index, origin_mask);
+        BIT_SCAN_FORWARD_64(&destination_square_index, destination_mask);
+    }
+    out[0] = 'a' + FILE(origin_square_index);
+    out[1] = '8' - RANK(origin_square_index);
+    out[2] = 'a' + FILE(destination_square_index);
+    out[3] = '8' - RANK(destination_square_index);
+    out[4] = 0;
+    PieceType piece_type = move->pieces[move->squares[destination_square_index]].piece_type;
+    if (position->pieces[position->squares[origin_square_index]].piece_type != piece_type)
+    {
+        out[4] = "bknqr"[piece_type];
+        out[5] = 0;
+    }
+}
+
+void search_mate(Position*position)
+{
+    uint64_t start_time = get_time();
+    g_search_mode = SEARCH_MODE_PROOF_NUMBER;
+    if (!init_position_tree(get_position_tree_node_capacity(g_position_tree_byte_count)))
+    {
+        printf("unresolved: out of memory\n");
+        return;
+    }
+    init_position_tree_root(position);
+    init_proof_number_search();
+    while (do_proof_number_iteration())
+    {
+    }
+    uint64_t elapsed_time = get_time() - start_time;
+    NodeIndex move_node_index = get_proving_move_node_index();
+    if (move_node_index != NULL_POSITION_TREE_NODE)
+    {
+        Position move;
+        decompress_position(&move, move_node_index);
+        char move_string[6];
+        get_move_string(position, &move, move_string);
+        printf("mate: %s\n", move_string);
+    }
+    else if (!g_proof_numbers->disproof_number)
+    {
+        printf("no forced mate\n");
+    }
+    else if (proof_numbers_are_blocked(g_proof_numbers))
+    {
+        printf("unresolved: every line reaches the search horizon\n");
+    }
+    else
+    {
+        printf("unresolved: out of memory\n");
+    }
+    printf("\nnodes: %llu\ntime: %.3f s\n",
+        (unsigned long long)g_index_of_first_free_position_tree_node,
+        (double)elapsed_time / get_counts_per_second());
+    release_position_tree();
+}
+
+void play_move(Position*position, uint64_t seconds)
+{
+    if (!init_engine())
+    {
+        printf("out of memory\n");
+        return;
+    }
+    send_engine_command(&(EngineCommand) { .type = ENGINE_COMMAND_SET_POSITION,
+        .position = *position });
+    EngineResult result;
+    while (!poll_engine_result(&result))
+    {
+        sleep_milliseconds(1);
+    }
+    if (result.type == ENGINE_RESULT_POSITION_READY)
+    {
+        send_engine_command(&(EngineCommand) { .type = ENGINE_COMMAND_START,
+            .clock = { .time_left = seconds * get_counts_per_second(),
+                .turn_start_time = get_time() } });
+        while (!poll_engine_result(&result))
+        {
+            sleep_milliseconds(1);
+        }
+    }
+    switch (result.type)
+    {
+    case ENGINE_RESULT_CHECKMATE:
+    {
+        printf("checkmate\n");
+        break;
+    }
+    case ENGINE_RESULT_STALEMATE:
+    {
+        printf("stalemate\n");
+        break;
+    }
+    default:
+    {
+        char move_string[6];
+        get_move_string(position, g_legal_moves + result.move_index, move_string);
+        printf("best move: %s\n", move_string);
+    }
+    }
+}
+
+int main(int argument_count, char**arguments)
+{
+    uint8_t depth = 0;
+    uint8_t thread_count = 1;
+    bool bulk_count = true;
+    bool mate = false;
+    uint64_t play_seconds = 0;
+    char fen[256] = { 0 };
+    for (int i = 1; i < argument_count; ++i)
+    {
+        if (!strcmp(arguments[i], "-threads") && i + 1 < argument_count)
+        {
+            ++i;
+            thread_count = atoi(arguments[i]);
+        }
+        else if (!strcmp(arguments[i], "-nobulk"))
+        {
+            bulk_count = false;
+        }
+        else if (!strcmp(arguments[i], "-mate"))
+        {
+            mate = true;
+        }
+        else if (!strcmp(arguments[i], "-play") && i + 1 < argument_count)
+        {
+            ++i;
+            play_seconds = atoi(arguments[i]);
+        }
+        else if (!strcmp(arguments[i], "-alphabeta"))
+        {
+            g_search_mode = SEARCH_MODE_ALPHA_BETA;
+        }
+        else if (!strcmp(arguments[i], "-memory") && i + 1 < argument_count)
+        {
+            ++i;
+            g_position_tree_byte_count = (uint64_t)atoi(arguments[i]) << 20;
+        }
+        else if (!depth && !mate && !play_seconds)
+        {
+            depth = atoi(arguments[i]);
+        }
+        else if (strlen(fen) + strlen(arguments[i]) + 2 < sizeof(fen))
+        {
+            if (fen[0])
+            {
+                strcat(fen, " ");
+            }
+            strcat(fen, arguments[i]);
+        }
+    }
+    if ((!depth && !mate && !play_seconds) || !thread_count || thread_count > MAX_THREAD_COUNT)
+    {
+        printf("usage: perft depth [-threads count] [-nobulk] [-memory megabytes] [fen]\n"
+            "       perft -mate [-memory megabytes] [fen]\n"
+            "       perft -play seconds [-alphabeta] [-memory megabytes] [fen]\n");
+        return 1;
+    }
+    init_attack_tables();
+    init_zobrist_keys();
+    Position position;
+    if (!load_fen(&position, fen[0] ? fen : g_start_position_fen))
+    {
+        printf("invalid fen\n");
+        return 1;
+    }
+    if (mate)
+    {
+        search_mate(&position);
+        return 0;
+    }
+    if (play_seconds)
+    {
+        play_move(&position, play_seconds);
+        return 0;
+    }
+    uint64_t start_time = get_time();
+    if (!init_position_tree(2 * MAX_MOVE_COUNT))
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+    Position root_moves[MAX_MOVE_COUNT];
+    uint8_t root_move_count = get_children(&position, root_moves);
+    release_position_tree();
+    uint64_t root_move_leaf_counts[MAX_MOVE_COUNT];
+    PerftThread threads[MAX_THREAD_COUNT];
+    Thread thread_handles[MAX_THREAD_COUNT];
+    for (uint8_t i = 0; i < thread_count; ++i)
+    {
+        threads[i] = (PerftThread) { root_moves, root_move_leaf_counts, root_move_count, i,
+            thread_count, depth, bulk_count };
+    }
+    for (uint8_t i = 1; i < thread_count; ++i)
+    {
+        thread_handles[i] = create_thread(count_root_move_leaves, threads + i);
+    }
+    count_root_move_leaves(threads);
+    for (uint8_t i = 1; i < thread_count; ++i)
+    {
+        join_thread(thread_handles[i]);
+    }
+    uint64_t elapsed_time = get_time() - start_time;
+    uint64_t leaf_count = 0;
+    for (uint8_t i = 0; i < root_move_count; ++i)
+    {
+        char move_string[6];
+        get_move_string(&position, root_moves + i, move_string);
+        printf("%s: %llu\n", move_string, (unsigned long long)root_move_leaf_counts[i]);
+        leaf_count += root_move_leaf_counts[i];
+    }
+    double seconds = (double)elapsed_time / get_counts_per_second();
+    printf("\nnodes: %llu\ntime: %.3f s\nnodes/second: %.0f\n", (unsigned long long)leaf_count,
+        seconds, seconds > 0 ? leaf_count / seconds : 0);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1 @@
+cl perft.c /O2
\ No newline at end of file
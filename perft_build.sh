@@ -0,0 +1 @@
+gcc perft.c -O2 -march=native -o perft -lpthread
\ No newline at end of file
@@ -0,0 +1,18 @@
+gcc perft.c -O2 -DDEBUG -march=native -o perft_test -lpthread || exit 1
+status=0
+check()
+{
+    output=$(./perft_test "$@" 2>&1)
+    if [ "$output" != "$expected" ]; then
+        echo "FAIL: perft $*: expected '$expected', got '$output'"
+        status=1
+    fi
+}
+for mode in "" -alphabeta; do
+    expected="checkmate"
+    check -play 1 $mode rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3
+    expected="stalemate"
+    check -play 1 $mode 7k/5Q2/6K1/8/8/8/8/8 b - - 0 1
+done
+rm -f perft_test
+exit $status
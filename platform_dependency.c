@@ -1,3 +1,4 @@
+#ifdef _WIN32
 #include <windows.h>
 #include <intrin.h>
 
@@ -12,11 +13,172 @@ typedef enum KeyId
 
 #define ALLOCATE(size) VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE)
 #define FREE_MEMORY(address) VirtualFree(address, 0, MEM_RELEASE)
+#define RESERVE_MEMORY(size) VirtualAlloc(0, size, MEM_RESERVE, PAGE_READWRITE)
+#define COMMIT_MEMORY(address, size) (VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != 0)
+#define RELEASE_MEMORY(address, size) VirtualFree(address, 0, MEM_RELEASE)
+#define MEMORY_PAGE_SIZE 4096
 #define BIT_SCAN_REVERSE(index, mask) _BitScanReverse(index, mask)
+#define BIT_SCAN_FORWARD(index, mask) _BitScanForward(index, mask)
+#define BIT_SCAN_FORWARD_64(index, mask) _BitScanForward64(index, mask)
+#define BIT_SCAN_REVERSE_64(index, mask) _BitScanReverse64(index, mask)
+#define THREAD_LOCAL __declspec(thread)
+#define THREAD_PROCEDURE(name, parameter) DWORD WINAPI name(void*parameter)
+#define ATOMIC_INCREMENT(counter) InterlockedIncrement(counter)
+#define ATOMIC_ADD(counter, value) InterlockedAdd(counter, value)
+#define ATOMIC_LOAD(counter) InterlockedCompareExchange(counter, 0, 0)
+
+typedef HANDLE Thread;
+typedef HANDLE Semaphore;
+typedef volatile LONG AtomicCounter;
 
 uint64_t get_time()
 {
     LARGE_INTEGER time;
     QueryPerformanceCounter(&time);
     return time.QuadPart;
-}
\ No newline at end of file
+}
+
+uint64_t get_counts_per_second()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return frequency.QuadPart;
+}
+
+Thread create_thread(LPTHREAD_START_ROUTINE procedure, void*parameter)
+{
+    return CreateThread(0, 0, procedure, parameter, 0, 0);
+}
+
+void join_thread(Thread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+Semaphore create_semaphore(void)
+{
+    return CreateSemaphore(0, 0, MAXLONG, 0);
+}
+
+void wait_semaphore(Semaphore semaphore)
+{
+    WaitForSingleObject(semaphore, INFINITE);
+}
+
+void signal_semaphore(Semaphore semaphore)
+{
+    ReleaseSemaphore(semaphore, 1, 0);
+}
+
+uint32_t get_processor_count(void)
+{
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    return system_info.dwNumberOfProcessors;
+}
+
+void sleep_milliseconds(uint32_t milliseconds)
+{
+    Sleep(milliseconds);
+}
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#define ALLOCATE(size) calloc(1, size)
+#define FREE_MEMORY(address) free(address)
+#define RESERVE_MEMORY(size) reserve_memory(size)
+#define COMMIT_MEMORY(address, size) !mprotect(address, size, PROT_READ | PROT_WRITE)
+#define RELEASE_MEMORY(address, size) release_memory(address, size)
+#define MEMORY_PAGE_SIZE 4096
+#define BIT_SCAN_REVERSE(index, mask) (*(index) = 31 - __builtin_clz(mask))
+#define BIT_SCAN_FORWARD(index, mask) (*(index) = __builtin_ctz(mask))
+#define BIT_SCAN_FORWARD_64(index, mask) (*(index) = __builtin_ctzll(mask))
+#define BIT_SCAN_REVERSE_64(index, mask) (*(index) = 63 - __builtin_clzll(mask))
+#define THREAD_LOCAL __thread
+#define THREAD_PROCEDURE(name, parameter) void*name(void*parameter)
+#define ATOMIC_INCREMENT(counter) __atomic_add_fetch(counter, 1, __ATOMIC_SEQ_CST)
+#define ATOMIC_ADD(counter, value) __atomic_add_fetch(counter, value, __ATOMIC_SEQ_CST)
+#define ATOMIC_LOAD(counter) __atomic_load_n(counter, __ATOMIC_ACQUIRE)
+
+typedef pthread_t Thread;
+typedef sem_t*Semaphore;
+typedef volatile int32_t AtomicCounter;
+
+uint64_t get_time()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return 1000000000 * (uint64_t)time.tv_sec + time.tv_nsec;
+}
+
+uint64_t get_counts_per_second()
+{
+    return 1000000000;
+}
+
+void*reserve_memory(size_t size)
+{
+    void*out = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (out == MAP_FAILED)
+    {
+        return 0;
+    }
+    return out;
+}
+
+void release_memory(void*address, size_t size)
+{
+    if (address)
+    {
+        munmap(address, size);
+    }
+}
+
+Thread create_thread(void*(*procedure)(void*), void*parameter)
+{
+    Thread thread;
+    pthread_create(&thread, 0, procedure, parameter);
+    return thread;
+}
+
+void join_thread(Thread thread)
+{
+    pthread_join(thread, 0);
+}
+
+Semaphore create_semaphore(void)
+{
+    Semaphore out = malloc(sizeof(sem_t));
+    sem_init(out, 0, 0);
+    return out;
+}
+
+void wait_semaphore(Semaphore semaphore)
+{
+    sem_wait(semaphore);
+}
+
+void signal_semaphore(Semaphore semaphore)
+{
+    sem_post(semaphore);
+}
+
+uint32_t get_processor_count(void)
+{
+    return sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+void sleep_milliseconds(uint32_t milliseconds)
+{
+    struct timespec duration = { milliseconds / 1000, (milliseconds % 1000) * 1000000 };
+    nanosleep(&duration, 0);
+}
+#endif
\ No newline at end of file
@@ -77,6 +77,7 @@ char g_start_window_class_name[] = "Start";
 void run_game_over_dialog(HWND main_window_handle)
 {
     KillTimer(main_window_handle, 1);
+    send_engine_command(&(EngineCommand) { .type = ENGINE_COMMAND_STOP });
     if (g_dialog_handle)
     {
         DestroyWindow(g_dialog_handle);
@@ -162,20 +163,7 @@ void run_message_loop(HWND main_window_handle)
     while (true)
     {
         MSG message;
-        if (g_run_engine)
-        {
-            while (PeekMessage(&message, 0, 0, 0, PM_REMOVE))
-            {
-                if (message.message == WM_QUIT)
-                {
-                    return;
-                }
-                TranslateMessage(&message);
-                DispatchMessage(&message);
-            }
-            handle_turn_action(main_window_handle, do_engine_iteration());
-        }
-        else if (GetMessage(&message, 0, 0, 0))
+        if (GetMessage(&message, 0, 0, 0))
         {
             TranslateMessage(&message);
             DispatchMessage(&message);
@@ -449,7 +437,9 @@ LRESULT CALLBACK main_window_proc(HWND window_handle, UINT message, WPARAM w_par
                 g_status_data.text = "Black is out of time. White wins.";
             }
             run_game_over_dialog(window_handle);
+            return 0;
         }
+        handle_turn_action(window_handle, handle_engine_result());
         return 0;
     }
     }
@@ -573,7 +563,11 @@ HWND windows_init(void)
     ReadFile(file_handle, (void*)((uintptr_t)font_data + text_font_data_size),
         icon_font_file_size.QuadPart, 0, 0);
     CloseHandle(file_handle);
-    init(font_data, text_font_data_size, icon_font_file_size.QuadPart);
+    if (!init(font_data, text_font_data_size, icon_font_file_size.QuadPart))
+    {
+        MessageBoxA(0, "Not enough memory for the position tree.", "Chess", MB_ICONERROR);
+        return 0;
+    }
     g_status_data.text = "";
     init_start_window(g_status_data.text, dpi);
     run_dialog(g_windows + WINDOW_START, dialog_handle, 0);
@@ -596,6 +590,37 @@ HWND windows_init(void)
 int WINAPI wWinMain(HINSTANCE instance_handle, HINSTANCE previous_instance_handle,
     PWSTR command_line, int show)
 {
+    if (wcsstr(command_line, L"-alphabeta"))
+    {
+        g_search_mode = SEARCH_MODE_ALPHA_BETA;
+    }
+    else if (wcsstr(command_line, L"-rootsplit"))
+    {
+        g_search_mode = SEARCH_MODE_ROOT_SPLIT;
+    }
+    else if (wcsstr(command_line, L"-mate"))
+    {
+        g_search_mode = SEARCH_MODE_PROOF_NUMBER;
+    }
+    if (wcsstr(command_line, L"-ponder"))
+    {
+        g_ponder = true;
+    }
+    wchar_t*memory_argument = wcsstr(command_line, L"-memory ");
+    if (memory_argument)
+    {
+        g_position_tree_byte_count = (uint64_t)_wtoi64(memory_argument + 8) << 20;
+    }
+    wchar_t*threads_argument = wcsstr(command_line, L"-threads ");
+    if (threads_argument)
+    {
+        g_engine_thread_count = _wtoi(threads_argument + 9);
+    }
+    wchar_t*selective_argument = wcsstr(command_line, L"-selective ");
+    if (selective_argument)
+    {
+        g_skipped_move_margin = _wtoi(selective_argument + 11);
+    }
     HWND main_window_handle = windows_init();
     if (main_window_handle)
     {